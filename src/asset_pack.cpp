@@ -0,0 +1,120 @@
+#pragma once
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include "atlas.cpp"
+#include "log.cpp"
+
+// Textures baked offline by pack_assets into one file, read through mmap.
+// Layout, native endianness:
+//   Header
+//   Entry[count], sorted by id
+//   pixels of every entry at Entry::offset, ENTRY_ALIGN aligned
+// Pixels are RGBA, flipped like stbi_set_flip_vertically_on_load(true) and extruded by Entry::padding,
+// so they go into an atlas region with a single TexturePage::upload() straight from the mapping
+class AssetPack {
+public:
+    constexpr static char MAGIC[8] = {'T', 'U', 'R', 'N', 'P', 'A', 'C', 'K'};
+    constexpr static uint32_t VERSION = 1;
+    constexpr static size_t ENTRY_ALIGN = 64;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t count;
+    };
+    struct Entry {
+        // fnv1a() of the path the game asks for, ex. "assets/ship01.png" (see ResourceId)
+        uint64_t id;
+        // from the start of the file
+        uint64_t offset;
+        // without padding
+        uint32_t w, h;
+        uint32_t padding;
+        // the atlas samples GL_NEAREST without mips, packs carry the base level only for now
+        uint32_t levels;
+    };
+    static inline size_t pixels_size(const Entry& entry) {
+        return size_t(entry.w + 2 * entry.padding) * (entry.h + 2 * entry.padding) * 4;
+    }
+
+private:
+    const u_char* _data = nullptr;
+    size_t _size = 0;
+    const Entry* _entries = nullptr;
+    uint32_t _count = 0;
+
+    bool _validate(const char* path) {
+        if (_size < sizeof(Header)) LERRRET(false, "asset pack {} is truncated", path);
+        Header header;
+        std::memcpy(&header, _data, sizeof(header));
+        if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC))) LERRRET(false, "{} is not an asset pack", path);
+        if (header.version != VERSION) LERRRET(false, "asset pack {} is version {}, expected {}, rebuild it", path, header.version, VERSION);
+        if (_size < sizeof(Header) + size_t(header.count) * sizeof(Entry)) LERRRET(false, "asset pack {} is truncated", path);
+        _entries = reinterpret_cast<const Entry*>(_data + sizeof(Header));
+        _count = header.count;
+        for (uint32_t i = 0; i < _count; i++) {
+            const Entry& entry = _entries[i];
+            if (entry.padding != TextureAtlas::PADDING) LERRRET(false, "asset pack {} has another atlas padding, rebuild it", path);
+            if (entry.offset > _size || pixels_size(entry) > _size - entry.offset) LERRRET(false, "asset pack {} is truncated", path);
+            // find() bisects, ids must strictly increase
+            if (i && _entries[i - 1].id >= entry.id) LERRRET(false, "asset pack {} is not sorted by id, rebuild it", path);
+        }
+        return true;
+    }
+
+public:
+    AssetPack() = default;
+    AssetPack(const AssetPack&) = delete;
+    AssetPack& operator=(const AssetPack&) = delete;
+    ~AssetPack() { close(); }
+
+    // false if there is no usable pack at path, everything is loaded from loose files then
+    bool open(const char* path) {
+        close();
+        const int fd = ::open(path, O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        // the mapping keeps the file alive
+        ::close(fd);
+        if (data == MAP_FAILED) LERRRET(false, "failed to map asset pack {}: {}", path, std::strerror(errno));
+        _data = static_cast<const u_char*>(data);
+        _size = st.st_size;
+        if (!_validate(path)) {
+            close();
+            return false;
+        }
+        LDEBUG("asset pack {}: {} textures, {} bytes", path, _count, _size);
+        return true;
+    }
+    void close() {
+        if (_data) munmap(const_cast<u_char*>(_data), _size);
+        _data = nullptr;
+        _size = 0;
+        _entries = nullptr;
+        _count = 0;
+    }
+
+    // nullptr if the pack has no such entry
+    const Entry* find(const uint64_t id) const {
+        const Entry* end = _entries + _count;
+        const Entry* it = std::lower_bound(_entries, end, id, [](const Entry& entry, const uint64_t id) { return entry.id < id; });
+        return it != end && it->id == id ? it : nullptr;
+    }
+    // pixels_size(entry) bytes, valid while the pack is open
+    inline const u_char* pixels(const Entry& entry) const { return _data + entry.offset; }
+    inline bool is_open() const { return _data; }
+};
@@ -0,0 +1,154 @@
+#pragma once
+#include <sys/types.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "log.cpp"
+#include "texture.cpp"
+
+// skyline bottom-left rectangle packer
+class SkylinePacker {
+    struct Node {
+        int x, y, w;
+    };
+    std::vector<Node> _skyline;
+    int _w, _h;
+
+    // lowest y at which a rectangle of width w fits starting at node i, -1 if it does not
+    int _fit(const size_t i, const int w, const int h) const {
+        if (_skyline[i].x + w > _w) return -1;
+        int y = 0;
+        int left = w;
+        for (size_t j = i; left > 0; j++) {
+            if (j == _skyline.size()) return -1;
+            y = std::max(y, _skyline[j].y);
+            if (y + h > _h) return -1;
+            left -= _skyline[j].w;
+        }
+        return y;
+    }
+
+public:
+    SkylinePacker(const int w, const int h) : _skyline{{0, 0, w}}, _w(w), _h(h) {}
+
+    bool insert(const int w, const int h, int& out_x, int& out_y) {
+        size_t best = SIZE_MAX;
+        int best_y = INT_MAX, best_w = INT_MAX;
+        for (size_t i = 0; i < _skyline.size(); i++) {
+            const int y = _fit(i, w, h);
+            if (y < 0) continue;
+            if (y < best_y || (y == best_y && _skyline[i].w < best_w)) {
+                best = i;
+                best_y = y;
+                best_w = _skyline[i].w;
+            }
+        }
+        if (best == SIZE_MAX) return false;
+        out_x = _skyline[best].x;
+        out_y = best_y;
+
+        // raise the skyline under the new rectangle
+        _skyline.insert(_skyline.begin() + best, {out_x, out_y + h, w});
+        for (size_t i = best + 1; i < _skyline.size();) {
+            Node& prev = _skyline[i - 1];
+            Node& node = _skyline[i];
+            const int shrink = prev.x + prev.w - node.x;
+            if (shrink <= 0) break;
+            node.x += shrink;
+            node.w -= shrink;
+            if (node.w > 0) break;
+            _skyline.erase(_skyline.begin() + i);
+        }
+        // merge neighbours of the same height
+        for (size_t i = 1; i < _skyline.size();) {
+            if (_skyline[i - 1].y == _skyline[i].y) {
+                _skyline[i - 1].w += _skyline[i].w;
+                _skyline.erase(_skyline.begin() + i);
+            } else
+                i++;
+        }
+        return true;
+    }
+};
+
+// packs RGBA images into shared TexturePages so mixed sprites can be drawn from one bound texture.
+// Headless builds keep only the padding helpers, for pack_assets
+class TextureAtlas {
+public:
+    constexpr static uint PAGE_SIZE = 2048;
+    // each image gets its edge pixels repeated PADDING times around it,
+    // so rounding at GL_NEAREST sampling never reads a neighbour
+    constexpr static uint PADDING = 1;
+
+    // bytes of a w x h image with its padding
+    static inline size_t padded_size(const uint w, const uint h) { return size_t(w + 2 * PADDING) * (h + 2 * PADDING) * 4; }
+    // copies image into out (padded_size() bytes) with extruded borders
+    static void extrude(const u_char* rgba, const uint w, const uint h, u_char* out) {
+        const uint pw = w + 2 * PADDING, ph = h + 2 * PADDING;
+        for (uint y = 0; y < ph; y++) {
+            const uint sy = std::clamp<int>(int(y) - int(PADDING), 0, int(h) - 1);
+            for (uint x = 0; x < pw; x++) {
+                const uint sx = std::clamp<int>(int(x) - int(PADDING), 0, int(w) - 1);
+                std::memcpy(&out[(size_t(y) * pw + x) * 4], &rgba[(size_t(sy) * w + sx) * 4], 4);
+            }
+        }
+    }
+
+#ifndef HEADLESS
+private:
+    struct Page {
+        std::unique_ptr<TexturePage> texture;
+        SkylinePacker packer;
+    };
+    std::vector<Page> _pages{};
+
+public:
+    // where an image goes, x/y/w/h include padding
+    struct Region {
+        const TexturePage* page;
+        uint x, y, w, h;
+        glm::vec4 uv;
+    };
+
+    TextureAtlas() = default;
+    TextureAtlas(const TextureAtlas&) = delete;
+    TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+    // packs a w x h image without uploading anything yet
+    Region reserve(const uint w, const uint h) {
+        const uint pw = w + 2 * PADDING, ph = h + 2 * PADDING;
+        int x = 0, y = 0;
+        Page* page = nullptr;
+        for (Page& p : _pages) {
+            if (p.packer.insert(pw, ph, x, y)) {
+                page = &p;
+                break;
+            }
+        }
+        if (!page) {
+            // images bigger than a page get their own
+            const uint size_w = std::max(PAGE_SIZE, pw), size_h = std::max(PAGE_SIZE, ph);
+            _pages.push_back({std::make_unique<TexturePage>(size_w, size_h), SkylinePacker(size_w, size_h)});
+            page = &_pages.back();
+            page->packer.insert(pw, ph, x, y);
+            LDEBUG("atlas page {} created ({}x{})", _pages.size() - 1, size_w, size_h);
+        }
+        const float page_w = page->texture->w(), page_h = page->texture->h();
+        return {page->texture.get(), uint(x), uint(y), pw, ph, {(x + PADDING) / page_w, (y + PADDING) / page_h, w / page_w, h / page_h}};
+    }
+
+    // packs and uploads right away
+    std::shared_ptr<Texture> add(const u_char* rgba, const uint w, const uint h) {
+        const Region region = reserve(w, h);
+        std::vector<u_char> padded(padded_size(w, h));
+        extrude(rgba, w, h, padded.data());
+        region.page->upload(region.x, region.y, region.w, region.h, padded.data());
+        return std::make_shared<Texture>(region.page, region.uv, w, h);
+    }
+    inline size_t pages_count() const { return _pages.size(); }
+#endif
+};
@@ -0,0 +1,400 @@
+// microbenchmarks of the engine hot paths plus a few whole-scene scenarios. Headless, runs without a display.
+// every benchmark is timed in --samples batches, a sample is the mean time of one op in its batch.
+// results (median, p99, min ns per op) go to --out: .csv, anything else is JSON
+#include <box2d/box2d.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "body_factory.cpp"
+#include "fleet.cpp"
+#include "globals.hpp"
+#include "log.cpp"
+#include "particles.cpp"
+#include "pool.cpp"
+#include "resource_manager.cpp"
+#include "ship.cpp"
+#include "sprite.cpp"
+#include "sprite_batch.cpp"
+#include "static_geometry.cpp"
+#include "transform.cpp"
+#include "utils.cpp"
+#include "world.cpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+// keeps the compiler from dropping a computation whose result is unused
+template <class T>
+inline void keep(const T& value) {
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+struct BenchOptions {
+    // substring of benchmark names to run, empty runs everything
+    std::string filter{};
+    size_t samples = 200;
+    // ops per sample are raised until a sample takes at least this long
+    double min_sample_us = 200.0;
+    const char* out = "turned_bench.json";
+    uint seed = 1;
+};
+
+static BenchOptions parse_options(int argc, char** argv) {
+    BenchOptions out{};
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!std::strcmp(argv[i], "--filter"))
+            out.filter = argv[i + 1];
+        else if (!std::strcmp(argv[i], "--samples"))
+            out.samples = std::max(1ul, std::strtoul(argv[i + 1], nullptr, 10));
+        else if (!std::strcmp(argv[i], "--min-sample-us"))
+            out.min_sample_us = std::strtod(argv[i + 1], nullptr);
+        else if (!std::strcmp(argv[i], "--out"))
+            out.out = argv[i + 1];
+        else if (!std::strcmp(argv[i], "--seed"))
+            out.seed = std::strtoul(argv[i + 1], nullptr, 10);
+        else
+            LWARN("unknown option {}", argv[i]);
+    }
+    if (argc % 2 == 0) LWARN("option {} has no value", argv[argc - 1]);
+    return out;
+}
+
+class Bench {
+public:
+    struct Result {
+        std::string name;
+        size_t ops;
+        size_t samples;
+        double median_ns, p99_ns, min_ns;
+    };
+
+private:
+    using clock = std::chrono::steady_clock;
+    const BenchOptions& _options;
+    std::vector<Result> _results{};
+
+    template <class F>
+    static double _time_ns(F& fn, const size_t ops) {
+        const clock::time_point start = clock::now();
+        fn(ops);
+        return std::chrono::duration<double, std::nano>(clock::now() - start).count();
+    }
+
+public:
+    Bench(const BenchOptions& options) : _options(options) {}
+
+    inline bool enabled(const std::string& name) const { return _options.filter.empty() || name.find(_options.filter) != std::string::npos; }
+
+    // fn(ops) performs `ops` operations. ops = 0 calibrates it to min_sample_us,
+    // scenarios that change state every op (world steps) pass 1
+    template <class F>
+    void run(const std::string& name, F&& fn, size_t ops = 0) {
+        if (!enabled(name)) return;
+        if (ops == 0) {
+            ops = 1;
+            while (_time_ns(fn, ops) < _options.min_sample_us * 1000.0 && ops < (1ul << 30)) { ops *= 2; }
+        }
+        std::vector<double> samples(_options.samples);
+        // warmup
+        fn(ops);
+        for (double& sample : samples) { sample = _time_ns(fn, ops) / ops; }
+        Result result{name, ops, samples.size()};
+        result.median_ns = percentile(samples, 0.5);
+        result.p99_ns = percentile(samples, 0.99);
+        result.min_ns = percentile(samples, 0.0);
+        LINFO("{:<40} {:>12.1f} {:>12.1f} {:>12.1f} {:>10}", name, result.median_ns, result.p99_ns, result.min_ns, ops);
+        _results.push_back(std::move(result));
+    }
+
+    bool write(const char* path) const {
+        std::FILE* file = std::fopen(path, "w");
+        if (!file) {
+            LERR("failed to open {}", path);
+            return false;
+        }
+        const bool csv = std::filesystem::path(path).extension() == ".csv";
+        if (csv)
+            std::fputs("name,ops,samples,median_ns,p99_ns,min_ns\n", file);
+        else
+            std::fprintf(file, "{\"version\":\"%s\",\"unit\":\"ns\",\"benchmarks\":[\n", PROJECT_VERSION);
+        for (size_t i = 0; i < _results.size(); i++) {
+            const Result& r = _results[i];
+            if (csv)
+                std::fprintf(file, "\"%s\",%zu,%zu,%.3f,%.3f,%.3f\n", r.name.c_str(), r.ops, r.samples, r.median_ns, r.p99_ns, r.min_ns);
+            else
+                std::fprintf(file, "%s{\"name\":\"%s\",\"ops\":%zu,\"samples\":%zu,\"median\":%.3f,\"p99\":%.3f,\"min\":%.3f}", i ? ",\n" : "", r.name.c_str(),
+                             r.ops, r.samples, r.median_ns, r.p99_ns, r.min_ns);
+        }
+        if (!csv) std::fputs("\n]}\n", file);
+        std::fclose(file);
+        LINFO("{} results written to {}", _results.size(), path);
+        return true;
+    }
+};
+
+// always turns towards and thrusts at the same point
+class SeekController final : public Ship::IController {
+    const glm::vec2 _target;
+
+public:
+    SeekController(const glm::vec2& target) : _target(target) {}
+    void update(const Input& input) override {}
+    Ship::InputFrame get(const Ship& ship) override { return {1.0, 0.25, _target}; }
+};
+
+// n dynamic circles on a grid inside a square of static boxes, moving in random directions.
+// pixel units like the game, body_factory scales them down
+class Scene {
+public:
+    b2WorldId world_id;
+    std::vector<b2BodyId> bodies{};
+
+    Scene(const size_t n, const uint seed) {
+        const b2WorldDef def = World::default_def();
+        world_id = b2CreateWorld(&def);
+        constexpr float spacing = 96.0f, tile = 64.0f, radius = 28.0f;
+        const size_t grid = std::ceil(std::sqrt(double(n)));
+        const size_t tiles_per_side = std::ceil(grid * spacing / tile) + 1;
+        const float half_extent = tiles_per_side * tile / 2.0f;
+        for (size_t i = 0; i < tiles_per_side; i++) {
+            const float along = -half_extent + tile * (i + 0.5f);
+            body_factory::box(world_id, b2_staticBody, tile, tile, Transform({along, -half_extent}, 0.0));
+            body_factory::box(world_id, b2_staticBody, tile, tile, Transform({along, half_extent}, 0.0));
+            body_factory::box(world_id, b2_staticBody, tile, tile, Transform({-half_extent, along}, 0.0));
+            body_factory::box(world_id, b2_staticBody, tile, tile, Transform({half_extent, along}, 0.0));
+        }
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> angle(0.0f, glm::two_pi<float>());
+        bodies.reserve(n);
+        for (size_t i = 0; i < n; i++) {
+            const glm::vec2 pos = glm::vec2(float(i % grid), float(i / grid)) * spacing - glm::vec2(grid * spacing / 2.0f);
+            bodies.push_back(body_factory::circle(world_id, b2_dynamicBody, radius, Transform(pos, 0.0)));
+            const float a = angle(rng);
+            b2Body_SetLinearVelocity(bodies.back(), {4.0f * std::cos(a), 4.0f * std::sin(a)});
+        }
+    }
+    Scene(const Scene&) = delete;
+    Scene& operator=(const Scene&) = delete;
+    ~Scene() { b2DestroyWorld(world_id); }
+};
+
+int main(int argc, char** argv) {
+    std::filesystem::current_path(std::filesystem::canonical("/proc/self/exe").parent_path());
+    _init_log(spdlog::level::info);
+    const BenchOptions options = parse_options(argc, argv);
+    LINFO("{} bench: {} samples, seed {}", PROJECT_NAME_VERSION, options.samples, options.seed);
+    LINFO("{:<40} {:>12} {:>12} {:>12} {:>10}", "ns per op", "median", "p99", "min", "ops");
+
+    Bench bench(options);
+    std::mt19937 rng(options.seed);
+    std::uniform_real_distribution<float> dist(-100.0f, 100.0f);
+    // inputs for the math benchmarks, cycled through
+    constexpr size_t INPUTS = 1024;
+    std::vector<glm::vec2> vectors(INPUTS);
+    for (glm::vec2& v : vectors) { v = {dist(rng), dist(rng)}; }
+
+    ResourceManager resource_manager{};
+    const std::shared_ptr<Texture> ship_texture = resource_manager.get_texture("assets/ship01.png");
+    const std::shared_ptr<Texture> wall_texture = resource_manager.get_texture("assets/wall01.png");
+
+    // scenarios
+    for (const size_t n : {100, 1000, 4000}) {
+        const std::string name = "b2World_Step/ships:" + std::to_string(n);
+        if (!bench.enabled(name)) continue;
+        Scene scene(n, options.seed);
+        bench.run(name, [&](size_t ops) {
+            for (size_t i = 0; i < ops; i++) { b2World_Step(scene.world_id, PHYSICS_DT, PHYSICS_SUBSTEPS_COUNT); }
+        }, 1);
+    }
+    for (const size_t n : {100, 1000}) {
+        const std::string name = "Ship::physics/ships:" + std::to_string(n);
+        if (!bench.enabled(name)) continue;
+        World world{};
+        std::vector<std::unique_ptr<Ship>> ships{};
+        const std::shared_ptr<SeekController> controller = std::make_shared<SeekController>(glm::vec2(0.0f));
+        for (size_t i = 0; i < n; i++) {
+            ships.push_back(std::make_unique<Ship>(ship_texture, world.get_id(), Transform(vectors[i % INPUTS] * 10.0f, 0.0)));
+            ships.back()->controller = controller;
+        }
+        bench.run(name, [&](size_t ops) {
+            for (size_t i = 0; i < ops; i++) {
+                for (const std::unique_ptr<Ship>& ship : ships) { ship->physics(PHYSICS_DT); }
+            }
+        });
+    }
+    for (const size_t n : {100, 1000}) {
+        const std::string name = "Fleet::update/ships:" + std::to_string(n);
+        if (!bench.enabled(name)) continue;
+        World world{};
+        world.ships.reserve(n);
+        Fleet fleet{};
+        for (size_t i = 0; i < n; i++) { fleet.add(world, world.spawn_ship(ship_texture, Transform(vectors[i % INPUTS] * 10.0f, 0.0))); }
+        bench.run(name, [&](size_t ops) {
+            for (size_t i = 0; i < ops; i++) { fleet.update(world, PHYSICS_DT); }
+        });
+    }
+    for (const size_t n : {100, 1000, 10000}) {
+        const std::string save_name = "World::save/ships:" + std::to_string(n), restore_name = "World::restore/ships:" + std::to_string(n);
+        if (!bench.enabled(save_name) && !bench.enabled(restore_name)) continue;
+        World world{};
+        world.ships.reserve(n);
+        const size_t grid = std::ceil(std::sqrt(double(n)));
+        const std::shared_ptr<SeekController> controller = std::make_shared<SeekController>(glm::vec2(0.0f));
+        for (size_t i = 0; i < n; i++) {
+            const Pool<Ship>::Handle ship = world.spawn_ship(ship_texture, Transform(glm::vec2(float(i % grid), float(i / grid)) * 96.0f, 0.0));
+            world.ships.get(ship)->set_velocity(vectors[i % INPUTS] / 25.0f);
+            world.ships.get(ship)->controller = controller;
+        }
+        world.step(PHYSICS_DT);
+        WorldState state{};
+        state.reserve(n);
+        world.save(state);
+        if (bench.enabled(save_name)) {
+            bench.run(save_name, [&](size_t ops) {
+                for (size_t i = 0; i < ops; i++) {
+                    world.save(state);
+                    keep(state);
+                }
+            });
+        }
+        if (bench.enabled(restore_name)) {
+            bench.run(restore_name, [&](size_t ops) {
+                for (size_t i = 0; i < ops; i++) { world.restore(state); }
+            });
+        }
+    }
+    for (const size_t n : {1000, 10000}) {
+        const std::string name = "SpriteBatch::submit+build/sprites:" + std::to_string(n);
+        if (!bench.enabled(name)) continue;
+        std::vector<Sprite> sprites{};
+        sprites.reserve(n);
+        for (size_t i = 0; i < n; i++) { sprites.emplace_back(ship_texture, Transform(vectors[i % INPUTS], double(i))); }
+        SpriteBatch batch{};
+        bench.run(name, [&](size_t ops) {
+            for (size_t i = 0; i < ops; i++) {
+                batch.begin();
+                for (const Sprite& sprite : sprites) { batch.submit(sprite, 0.5f); }
+                batch.build();
+                keep(batch.stats());
+            }
+        });
+    }
+
+    for (const size_t n : {1000, 10000}) {
+        // runs of walls like Sectors generates, every run merges into one box
+        const std::string name = "StaticGeometry::merge/tiles:" + std::to_string(n);
+        if (!bench.enabled(name)) continue;
+        std::vector<StaticGeometry::Tile> tiles{};
+        for (size_t i = 0; i < n; i++) {
+            const glm::vec2 start = vectors[i / 8 % INPUTS] * 100.0f;
+            const double angle = (i / 8) * 0.1;
+            tiles.push_back(StaticGeometry::tile(*wall_texture, Transform(start + glm::vec2(std::cos(angle), std::sin(angle)) * (float(i % 8) * wall_texture->w()), angle)));
+        }
+        std::vector<StaticGeometry::Box> boxes{};
+        bench.run(name, [&](size_t ops) {
+            for (size_t i = 0; i < ops; i++) {
+                boxes.clear();
+                StaticGeometry::merge(tiles, {}, boxes);
+                keep(boxes.size());
+            }
+        });
+    }
+    {
+        // a frame of exhaust at steady state: as many particles born as die, about 100k alive
+        const std::string name = "ParticleSystem::emit+update/particles:100000";
+        if (bench.enabled(name)) {
+            ParticleSystem particles{};
+            ParticleSystem::Material material{};
+            material.life = 1.0f;
+            material.capacity = 1 << 17;
+            particles.add_material(material);
+            constexpr float DT = 1.0f / 60.0f;
+            constexpr uint16_t BURST = 64;
+            const auto frame = [&](const size_t f) {
+                for (int i = 0; i < 100000 / 60 / BURST + 1; i++) {
+                    const glm::vec2 dir = glm::normalize(vectors[(f + i) % INPUTS] + glm::vec2(0.01f, 0.0f));
+                    particles.emit({vectors[i % INPUTS], vectors[(i + 1) % INPUTS], dir, 3.0f, 0.3f, DT, BURST, 0});
+                }
+                particles.update(DT);
+            };
+            for (size_t f = 0; f < 60; f++) frame(f);
+            bench.run(name, [&](size_t ops) {
+                for (size_t i = 0; i < ops; i++) {
+                    frame(i);
+                    keep(particles.stats());
+                }
+            });
+        }
+    }
+    for (const size_t n : {100, 1000}) {
+        const std::string name = "Pool::spawn+despawn/sprites:" + std::to_string(n);
+        if (!bench.enabled(name)) continue;
+        Pool<Sprite> pool{};
+        pool.reserve(n);
+        std::vector<Pool<Sprite>::Handle> handles(n);
+        // a burst of debris, then every other piece despawned and spawned again
+        for (size_t i = 0; i < n; i++) { handles[i] = pool.spawn(ship_texture, Transform(vectors[i % INPUTS], 0.0)); }
+        bench.run(name, [&](size_t ops) {
+            for (size_t i = 0; i < ops; i++) {
+                for (size_t j = i % 2; j < n; j += 2) { pool.despawn(handles[j]); }
+                for (size_t j = i % 2; j < n; j += 2) { handles[j] = pool.spawn(ship_texture, Transform(vectors[j % INPUTS], 0.0)); }
+                keep(pool.size());
+            }
+        });
+    }
+
+    // lookups
+    const char* paths[] = {"assets/ship01.png", "assets/wall02.png"};
+    for (const char* path : paths) { preload = resource_manager.get_texture(path); }
+    bench.run("ResourceManager::get_texture(path)", [&](size_t ops) {
+        for (size_t i = 0; i < ops; i++) { keep(resource_manager.get_texture(paths[i % 2])); }
+    });
+    {
+        constexpr ResourceId ids[] = {"assets/ship01.png", "assets/wall02.png"};
+        bench.run("ResourceManager::get_texture(id)", [&](size_t ops) {
+            for (size_t i = 0; i < ops; i++) { keep(resource_manager.get_texture(ids[i % 2])); }
+        });
+    }
+    preload = resource_manager.get_mesh_rect(0.0f, 0.0f, 64.0f, 64.0f);
+    bench.run("ResourceManager::get_mesh_rect", [&](size_t ops) {
+        for (size_t i = 0; i < ops; i++) { keep(i % 2 ? resource_manager.get_quad_1x1() : resource_manager.get_mesh_rect(0.0f, 0.0f, 64.0f, 64.0f)); }
+    });
+
+    // math
+    bench.run("Transform(pos, b2Rot)", [&](size_t ops) {
+        for (size_t i = 0; i < ops; i++) {
+            const glm::vec2& v = vectors[i % INPUTS];
+            keep(Transform(v, b2Rot{v.x, v.y}));
+        }
+    });
+    bench.run("Transform(pos, angle)", [&](size_t ops) {
+        for (size_t i = 0; i < ops; i++) { keep(Transform(vectors[i % INPUTS], double(i))); }
+    });
+    bench.run("Transform::lerp", [&](size_t ops) {
+        const Transform a(glm::vec2(0.0f), 0.0), b(glm::vec2(1.0f), 2.0);
+        for (size_t i = 0; i < ops; i++) { keep(Transform::lerp(a, b, float(i % 64) / 64.0f)); }
+    });
+    {
+        const Sprite sprite(ship_texture, Transform(glm::vec2(0.0f), 0.0));
+        bench.run("Sprite::get_instance", [&](size_t ops) {
+            for (size_t i = 0; i < ops; i++) { keep(sprite.get_instance(float(i % 64) / 64.0f)); }
+        });
+    }
+    bench.run("limit_length", [&](size_t ops) {
+        for (size_t i = 0; i < ops; i++) { keep(limit_length(vectors[i % INPUTS], 50.0f)); }
+    });
+    bench.run("oriented_angle_between", [&](size_t ops) {
+        for (size_t i = 0; i < ops; i++) { keep(oriented_angle_between(vectors[i % INPUTS], vectors[(i + 1) % INPUTS])); }
+    });
+
+    return bench.write(options.out) ? 0 : 1;
+}
@@ -24,4 +24,9 @@ public:
         projection = glm::ortho(-_dimensions.x / 2.0f, _dimensions.x / 2.0f, -_dimensions.y / 2.0f, _dimensions.y / 2.0f, 0.0f, 1.0f);
     }
     inline glm::vec2 get_dimensions() const { return _dimensions; }
+    // world-space rectangle get_view_projection() maps onto the screen
+    inline void get_visible_rect(glm::vec2& min, glm::vec2& max) const {
+        min = -pos - _dimensions / 2.0f;
+        max = -pos + _dimensions / 2.0f;
+    }
 };
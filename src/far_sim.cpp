@@ -0,0 +1,192 @@
+#pragma once
+#include <box2d/types.h>
+
+#include <cstdint>
+#include <glm/vec2.hpp>
+#include <vector>
+
+#include "globals.hpp"
+#include "pool.cpp"
+#include "ship.cpp"
+#include "transform.cpp"
+
+// coarse tier for ships outside of the active region.
+// their Box2D bodies are disabled and position/velocity are advanced here at FAR_PHYSICS_RATE,
+// still driven by their controllers. Promoting a ship gives its state back to Box2D
+class FarSimulation {
+    std::vector<Ship*> _ships{};
+    std::vector<Pool<Ship>::Handle> _handles{};
+    // physics units, SoA so the integration loop vectorizes
+    std::vector<float> _px{}, _py{}, _vx{}, _vy{};
+    std::vector<b2Rot> _rot{};
+    // before the last far step, sprites are interpolated from it to the current one
+    std::vector<Transform> _prev{};
+    double _accumulator = 0.0;
+    constexpr static double FAR_DT = 1.0 / FAR_PHYSICS_RATE;
+
+    // last ship takes the place of i
+    void _erase(const size_t i) {
+        _ships[i] = _ships.back();
+        _handles[i] = _handles.back();
+        _px[i] = _px.back();
+        _py[i] = _py.back();
+        _vx[i] = _vx.back();
+        _vy[i] = _vy.back();
+        _rot[i] = _rot.back();
+        _prev[i] = _prev.back();
+        _ships.pop_back();
+        _handles.pop_back();
+        _px.pop_back();
+        _py.pop_back();
+        _vx.pop_back();
+        _vy.pop_back();
+        _rot.pop_back();
+        _prev.pop_back();
+    }
+
+public:
+    // rollback, see World::save()
+    struct State {
+        Pool<Ship>::Handle ship;
+        glm::vec2 pos, vel;
+        b2Rot rot;
+    };
+
+private:
+    // restore() scratch: tier index by pool index, NONE for ships not in the tier
+    constexpr static uint32_t NONE = UINT32_MAX;
+    std::vector<uint32_t> _tier{};
+    std::vector<bool> _kept{};
+    std::vector<std::pair<Ship*, const State*>> _joining{};
+
+public:
+
+    void add(Ship* ship, const Pool<Ship>::Handle handle) {
+        const Transform transform = ship->get_transform();
+        const glm::vec2 vel = ship->get_velocity();
+        ship->demote();
+        _ships.push_back(ship);
+        _handles.push_back(handle);
+        _px.push_back(transform.pos.x);
+        _py.push_back(transform.pos.y);
+        _vx.push_back(vel.x);
+        _vy.push_back(vel.y);
+        _rot.push_back(transform.rot);
+        _prev.push_back(transform);
+    }
+    // gives the ship back to Box2D
+    void promote(const size_t i) {
+        const Transform transform({_px[i], _py[i]}, _rot[i]);
+        _ships[i]->set_far_transform(transform);
+        _ships[i]->set_far_sprite(transform);
+        _ships[i]->promote({_vx[i], _vy[i]});
+        _erase(i);
+    }
+    // forgets a ship about to be destroyed, its body stays disabled
+    void remove(const Ship* ship) {
+        for (size_t i = 0; i < _ships.size(); i++) {
+            if (_ships[i] != ship) continue;
+            _erase(i);
+            return;
+        }
+    }
+    // promotes every ship within radius of focus (physics units)
+    void promote_near(const glm::vec2& focus, const float radius) {
+        const float r2 = radius * radius;
+        for (size_t i = 0; i < _ships.size();) {
+            const float dx = _px[i] - focus.x, dy = _py[i] - focus.y;
+            if (dx * dx + dy * dy < r2)
+                promote(i);
+            else
+                i++;
+        }
+    }
+
+    // in tier order, out keeps its capacity
+    void save(std::vector<State>& out) const {
+        out.clear();
+        for (size_t i = 0; i < _ships.size(); i++) { out.push_back({_handles[i], {_px[i], _py[i]}, {_vx[i], _vy[i]}, _rot[i]}); }
+    }
+    // back to saved (see save()), ships are looked up in pool. The ones far both now and then are overwritten in place,
+    // only those whose tier differs are promoted or demoted: Box2D creates or destroys a broadphase proxy for each of them
+    void restore(Pool<Ship>& pool, const std::vector<State>& saved) {
+        for (size_t i = 0; i < _ships.size(); i++) {
+            if (_handles[i].index >= _tier.size()) _tier.resize(_handles[i].index + 1, NONE);
+            _tier[_handles[i].index] = i;
+        }
+        _kept.assign(_ships.size(), false);
+        _joining.clear();
+        for (const State& state : saved) {
+            Ship* ship = pool.get(state.ship);
+            if (!ship) continue;
+            const uint32_t i = state.ship.index < _tier.size() ? _tier[state.ship.index] : NONE;
+            if (i == NONE || _handles[i] != state.ship) {
+                _joining.emplace_back(ship, &state);
+                continue;
+            }
+            _px[i] = state.pos.x;
+            _py[i] = state.pos.y;
+            _vx[i] = state.vel.x;
+            _vy[i] = state.vel.y;
+            _rot[i] = state.rot;
+            _prev[i] = Transform(state.pos, state.rot);
+            ship->restore({{{state.pos.x, state.pos.y}, state.rot}, {0.0f, 0.0f}, 0.0f, false});
+            _kept[i] = true;
+        }
+        for (size_t i = 0; i < _ships.size(); i++) { _tier[_handles[i].index] = NONE; }
+        // backwards, _erase() moves the last ship into i and that one is kept already
+        for (size_t i = _ships.size(); i-- > 0;) {
+            if (!_kept[i]) promote(i);
+        }
+        for (const auto& [ship, state] : _joining) { restore(ship, *state); }
+    }
+    // adds ship with a saved state instead of its body's
+    void restore(Ship* ship, const State& state) {
+        ship->restore({{{state.pos.x, state.pos.y}, state.rot}, {0.0f, 0.0f}, 0.0f, false});
+        ship->demote();
+        _ships.push_back(ship);
+        _handles.push_back(state.ship);
+        _px.push_back(state.pos.x);
+        _py.push_back(state.pos.y);
+        _vx.push_back(state.vel.x);
+        _vy.push_back(state.vel.y);
+        _rot.push_back(state.rot);
+        _prev.push_back(Transform(state.pos, state.rot));
+    }
+    inline double get_accumulator() const { return _accumulator; }
+    inline void set_accumulator(const double accumulator) { _accumulator = accumulator; }
+
+    // sprites trail the far state by one far step: each tick they move on from the last far transform towards the current
+    // one, so the render interpolation between ticks stays smooth instead of jumping at FAR_PHYSICS_RATE
+    void step(const double& dt) {
+        _accumulator += dt;
+        if (_accumulator >= FAR_DT) {
+            _accumulator -= FAR_DT;
+            _step();
+        }
+        const float alpha = float(_accumulator / FAR_DT);
+        for (size_t i = 0; i < _ships.size(); i++) {
+            _ships[i]->set_far_sprite(Transform::lerp(_prev[i], Transform({_px[i], _py[i]}, _rot[i]), alpha));
+        }
+    }
+
+    inline size_t size() const { return _ships.size(); }
+
+private:
+    void _step() {
+        const size_t n = _ships.size();
+        for (size_t i = 0; i < n; i++) { _prev[i] = Transform({_px[i], _py[i]}, _rot[i]); }
+        for (size_t i = 0; i < n; i++) {
+            glm::vec2 vel{_vx[i], _vy[i]};
+            _ships[i]->physics_far(FAR_DT, {_px[i], _py[i]}, vel, _rot[i]);
+            _vx[i] = vel.x;
+            _vy[i] = vel.y;
+        }
+        const float fdt = FAR_DT;
+        for (size_t i = 0; i < n; i++) {
+            _px[i] += _vx[i] * fdt;
+            _py[i] += _vy[i] * fdt;
+        }
+        for (size_t i = 0; i < n; i++) { _ships[i]->set_far_transform(Transform({_px[i], _py[i]}, _rot[i])); }
+    }
+};
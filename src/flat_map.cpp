@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// open addressing hash map with linear probing, keys and values stored inline in one array.
+// Hash returns a uint64_t that is already well mixed (ex. fnv1a()). No erase, entries live as long as the map
+template <class K, class V, class Hash>
+class FlatMap {
+    struct Slot {
+        K key{};
+        V value{};
+        bool used = false;
+    };
+    std::vector<Slot> _slots{};
+    size_t _size = 0;
+
+    // slot holding key, or the empty slot where it belongs
+    inline size_t _probe(const K& key) const {
+        const size_t mask = _slots.size() - 1;
+        size_t i = Hash{}(key) & mask;
+        while (_slots[i].used && !(_slots[i].key == key)) i = (i + 1) & mask;
+        return i;
+    }
+    void _grow() {
+        std::vector<Slot> old = std::move(_slots);
+        _slots = std::vector<Slot>(old.empty() ? 16 : old.size() * 2);
+        for (Slot& slot : old) {
+            if (slot.used) _slots[_probe(slot.key)] = std::move(slot);
+        }
+    }
+
+public:
+    // nullptr if missing
+    inline V* find(const K& key) {
+        if (_slots.empty()) return nullptr;
+        Slot& slot = _slots[_probe(key)];
+        return slot.used ? &slot.value : nullptr;
+    }
+    inline const V* find(const K& key) const { return const_cast<FlatMap*>(this)->find(key); }
+    // default-constructs a missing value
+    V& operator[](const K& key) {
+        // at most half full, so probe runs stay short
+        if ((_size + 1) * 2 > _slots.size()) _grow();
+        Slot& slot = _slots[_probe(key)];
+        if (!slot.used) {
+            slot.key = key;
+            slot.used = true;
+            _size++;
+        }
+        return slot.value;
+    }
+    inline size_t size() const { return _size; }
+};
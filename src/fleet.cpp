@@ -0,0 +1,238 @@
+#pragma once
+#include <box2d/math_functions.h>
+
+#include <cmath>
+#include <cstdint>
+#include <glm/geometric.hpp>
+#include <glm/vec2.hpp>
+#include <memory>
+#include <vector>
+
+#include "globals.hpp"
+#include "pool.cpp"
+#include "profiler.cpp"
+#include "ship.cpp"
+#include "simd.cpp"
+#include "task_scheduler.cpp"
+#include "world.cpp"
+
+// Steers many AI ships with one order. update() gathers the members near the focus into SoA arrays once per tick,
+// computes steering and PID-damped turning for f32x4::N ships per instruction, optionally spread over the scheduler,
+// and writes velocities and rotations back to Box2D in one pass. Call it right before World::step().
+// Members in the far tier head for the target through one shared scalar controller
+class Fleet {
+public:
+    enum class Order : uint8_t {
+        // full speed at the target
+        SEEK,
+        // slows down within Params::slow_radius, stops on the target
+        ARRIVE,
+        // circles the target counter-clockwise at Params::orbit_radius
+        ORBIT,
+    };
+    struct Params {
+        // physics units per second
+        float max_speed = 8.0f;
+        // physics units
+        float slow_radius = 4.0f;
+        // orbits tighter than max_speed^2 / acceleration drift outwards until the thrust can hold them
+        float orbit_radius = 8.0f;
+        // heading error (radians) to angular speed, clamped by Ship::get_angular_max_speed()
+        float turn_kP = 10.0f;
+        float turn_kI = 0.0f;
+        float turn_kD = 0.2f;
+    };
+
+    Order order = Order::SEEK;
+    // physics units, every member adds its own offset
+    glm::vec2 target{};
+    Params params{};
+
+private:
+    // shared by all members, a copy of the order so ships can outlive the fleet
+    class _FarController final : public Ship::IController {
+    public:
+        glm::vec2 target{};
+        float slow_radius = 0.0f;
+
+        _FarController() { batched = true; }
+        void update(const Input& input) override {}
+        // coarse: full thrust at the target until close, the order is picked up again once promoted
+        Ship::InputFrame get(const Ship& ship) override {
+            const bool close = glm::distance(ship.get_transform().pos, target) < slow_radius;
+            return {close ? 0.0 : 1.0, 0.0, target};
+        }
+    };
+    struct Member {
+        Pool<Ship>::Handle ship;
+        glm::vec2 offset;
+        // PID state, radians
+        float integral = 0.0f;
+        float prev_error = 0.0f;
+    };
+    std::vector<Member> _members{};
+    std::shared_ptr<_FarController> _far_controller = std::make_shared<_FarController>();
+
+    // members gathered this tick, arrays padded to a multiple of f32x4::N
+    std::vector<Ship*> _ships{};
+    std::vector<uint32_t> _member{};
+    std::vector<float> _px{}, _py{}, _vx{}, _vy{}, _hx{}, _hy{}, _tx{}, _ty{};
+    std::vector<float> _accel{}, _turn_max{}, _integral{}, _prev_error{};
+    // radians turned this tick
+    std::vector<float> _turn{};
+
+    void _resize(const size_t n) {
+        for (std::vector<float>* array : {&_px, &_py, &_vx, &_vy, &_hx, &_hy, &_tx, &_ty, &_accel, &_turn_max, &_integral, &_prev_error, &_turn})
+            array->resize(n);
+    }
+
+    // blocks [start, end) of f32x4::N ships
+    template <Order ORDER>
+    void _steer(const int start, const int end, const float dt) {
+        using v = f32x4;
+        const v one = v::splat(1.0f), eps = v::splat(1e-6f);
+        const v vdt = v::splat(dt), max_speed = v::splat(params.max_speed);
+        const v slow_radius = v::splat(params.slow_radius), orbit_radius = v::splat(params.orbit_radius);
+        const v kP = v::splat(params.turn_kP), kI = v::splat(params.turn_kI), kD = v::splat(params.turn_kD);
+        for (int block = start; block < end; block++) {
+            const size_t i = size_t(block) * v::N;
+            const v px = v::load(&_px[i]), py = v::load(&_py[i]);
+            v vx = v::load(&_vx[i]), vy = v::load(&_vy[i]);
+            const v dx = v::load(&_tx[i]) - px, dy = v::load(&_ty[i]) - py;
+            const v dist = sqrt(dx * dx + dy * dy);
+            const v inv = one / max(dist, eps);
+            const v ux = dx * inv, uy = dy * inv;
+
+            // desired velocity
+            v wx, wy;
+            if constexpr (ORDER == Order::SEEK) {
+                wx = ux * max_speed;
+                wy = uy * max_speed;
+            } else if constexpr (ORDER == Order::ARRIVE) {
+                const v speed = max_speed * min(dist / slow_radius, one);
+                wx = ux * speed;
+                wy = uy * speed;
+            } else {
+                // along the tangent, pulled in or pushed out by the distance to the circle
+                const v radial = max(min((dist - orbit_radius) / slow_radius, one), -one);
+                const v ox = radial * ux - uy, oy = radial * uy + ux;
+                const v scale = max_speed / max(sqrt(ox * ox + oy * oy), eps);
+                wx = ox * scale;
+                wy = oy * scale;
+            }
+
+            // thrust in any direction, limited like Ship::physics()
+            const v sx = wx - vx, sy = wy - vy;
+            const v limit = v::load(&_accel[i]) * vdt;
+            const v scale = min(one, limit / max(sqrt(sx * sx + sy * sy), eps));
+            vx = vx + sx * scale;
+            vy = vy + sy * scale;
+
+            // turn towards the desired velocity, atan2(0, 0) keeps the heading of ships that should stand still
+            const v hx = v::load(&_hx[i]), hy = v::load(&_hy[i]);
+            const v error = atan2(hx * wy - hy * wx, hx * wx + hy * wy);
+            const v integral = v::load(&_integral[i]) + error * vdt;
+            const v derivative = (error - v::load(&_prev_error[i])) / vdt;
+            const v turn_max = v::load(&_turn_max[i]);
+            const v omega = max(min(kP * error + kI * integral + kD * derivative, turn_max), -turn_max);
+            // a is a small angle, a few terms of the series are exact to float precision
+            const v a = omega * vdt, a2 = a * a;
+            const v s = a - a * a2 * v::splat(1.0f / 6.0f);
+            const v c = one - a2 * v::splat(0.5f) + a2 * a2 * v::splat(1.0f / 24.0f);
+            const v nx = hx * c - hy * s, ny = hx * s + hy * c;
+            const v norm = one / sqrt(nx * nx + ny * ny);
+
+            vx.store(&_vx[i]);
+            vy.store(&_vy[i]);
+            (nx * norm).store(&_hx[i]);
+            (ny * norm).store(&_hy[i]);
+            integral.store(&_integral[i]);
+            error.store(&_prev_error[i]);
+            a.store(&_turn[i]);
+        }
+    }
+
+public:
+    Fleet() = default;
+    Fleet(const Fleet&) = delete;
+    Fleet& operator=(const Fleet&) = delete;
+
+    // offset: physics units from the target, ex. a slot in a formation
+    void add(World& world, const Pool<Ship>::Handle handle, const glm::vec2& offset = {}) {
+        Ship* ship = world.ships.get(handle);
+        if (!ship) return;
+        ship->controller = _far_controller;
+        _members.push_back({handle, offset});
+    }
+    inline size_t size() const { return _members.size(); }
+
+    // scheduler: spreads steering over its workers, call from its owner thread
+    void update(World& world, const double dt, TaskScheduler* scheduler = nullptr) {
+        PROFILE_ZONE("Fleet::update");
+        _far_controller->target = target;
+        _far_controller->slow_radius = params.slow_radius;
+
+        // gather, despawned members are dropped
+        _ships.clear();
+        _member.clear();
+        _resize(0);
+        for (size_t m = 0; m < _members.size();) {
+            Member& member = _members[m];
+            Ship* ship = world.ships.get(member.ship);
+            if (!ship) {
+                member = _members.back();
+                _members.pop_back();
+                continue;
+            }
+            m++;
+            if (ship->is_far()) continue;
+            const Transform& transform = ship->get_sprite().transform;
+            const glm::vec2 vel = ship->get_velocity();
+            _ships.push_back(ship);
+            _member.push_back(m - 1);
+            _px.push_back(transform.pos.x);
+            _py.push_back(transform.pos.y);
+            _vx.push_back(vel.x);
+            _vy.push_back(vel.y);
+            // heading, see Ship::look_at()
+            _hx.push_back(transform.rot.s);
+            _hy.push_back(transform.rot.c);
+            _tx.push_back(target.x + member.offset.x);
+            _ty.push_back(target.y + member.offset.y);
+            _accel.push_back(ship->get_acceleration() / ZOOM_FACTOR);
+            _turn_max.push_back(ship->get_angular_max_speed());
+            _integral.push_back(member.integral);
+            _prev_error.push_back(member.prev_error);
+        }
+        const size_t n = _ships.size();
+        if (n == 0) return;
+        // padding lanes steer a resting ship at its own position
+        const int blocks = (n + f32x4::N - 1) / f32x4::N;
+        _resize(size_t(blocks) * f32x4::N);
+        for (size_t i = n; i < _hy.size(); i++) _hy[i] = 1.0f;
+
+        const auto steer = [&](const int start, const int end) {
+            switch (order) {
+                case Order::SEEK: _steer<Order::SEEK>(start, end, dt); break;
+                case Order::ARRIVE: _steer<Order::ARRIVE>(start, end, dt); break;
+                case Order::ORBIT: _steer<Order::ORBIT>(start, end, dt); break;
+            }
+        };
+        // blocks per job, about a thousand ships
+        constexpr int MIN_BLOCKS = 256;
+        if (scheduler && blocks > MIN_BLOCKS)
+            scheduler->parallel_for(blocks, MIN_BLOCKS, [&](int start, int end, uint32_t) { steer(start, end); });
+        else
+            steer(0, blocks);
+
+        // scatter, Box2D is written from this thread only
+        for (size_t i = 0; i < n; i++) {
+            Member& member = _members[_member[i]];
+            member.integral = _integral[i];
+            member.prev_error = _prev_error[i];
+            _ships[i]->set_velocity({_vx[i], _vy[i]});
+            // moving a body is a broadphase update, skipped for ships that barely turned
+            if (std::abs(_turn[i]) > 1e-4f) _ships[i]->set_transform(Transform({_px[i], _py[i]}, b2Rot{_hy[i], _hx[i]}));
+        }
+    }
+};
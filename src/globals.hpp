@@ -3,7 +3,18 @@
 // made for Box2D: they say its works better when objects are near 1.0 unit size.
 // the more ZOOM_FACTOR is, the less all physics size is
 constexpr double ZOOM_FACTOR = 64.0;
-// TODO: 60Hz timer for physics
 constexpr double PHYSICS_RATE = 60.0;
+constexpr double PHYSICS_DT = 1.0 / PHYSICS_RATE;
+// catch-up steps per frame before dropping time, keeps a slow frame from snowballing
+constexpr int MAX_PHYSICS_STEPS_PER_FRAME = 5;
 // Box2D
 constexpr int PHYSICS_SUBSTEPS_COUNT = 4;
+// ships further than this from the player leave Box2D and are integrated coarsely (see FarSimulation)
+constexpr double FAR_SIMULATION_RADIUS = 4096.0;
+constexpr double FAR_PHYSICS_RATE = 10.0;
+// world streaming (see Sectors): square sectors in pixels, loaded within SECTOR_LOAD_RADIUS sectors of the player
+// and dropped beyond SECTOR_UNLOAD_RADIUS, building/destroying at most SECTOR_SHAPES_PER_TICK collision shapes per tick
+constexpr double SECTOR_SIZE = 2048.0;
+constexpr int SECTOR_LOAD_RADIUS = 1;
+constexpr int SECTOR_UNLOAD_RADIUS = 2;
+constexpr int SECTOR_SHAPES_PER_TICK = 16;
@@ -0,0 +1,14 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// 64-bit FNV-1a, usable at compile time. Chain calls through seed to hash several parts
+constexpr uint64_t FNV1A_SEED = 0xcbf29ce484222325ull;
+constexpr uint64_t fnv1a(const std::string_view data, uint64_t seed = FNV1A_SEED) {
+    for (const char c : data) {
+        seed ^= uint8_t(c);
+        seed *= 0x100000001b3ull;
+    }
+    return seed;
+}
@@ -1,6 +1,10 @@
 #pragma once
+#ifndef HEADLESS
 #include <GLFW/glfw3.h>
+#endif
 
+#include <algorithm>
+#include <cstdint>
 #include <glm/vec2.hpp>
 #include <type_traits>
 
@@ -30,12 +34,14 @@ struct ActionBase {
 };
 
 struct Action : public ActionBase<> {
-    inline operator double() const {
-        if (state == ActionState::PRESSED || state == ActionState::JUST_PRESSED)
-            return 1.0;
-        else
-            return 0.0;
-    }
+    // fraction of the last tick the action was held, so a tap shorter than a tick still counts.
+    // only set where events are applied per tick, see Input::end_tick()
+    double held = 0.0;
+    // seconds held since the tick started
+    double _held_time = 0.0;
+
+    inline bool is_down() const { return state == ActionState::PRESSED || state == ActionState::JUST_PRESSED; }
+    inline operator double() const { return held; }
 };
 struct AnyCallbackAction : public ActionBase<AnyCallbackAction> {
     void (*callback)(void* userdata, const ActionState state){nullptr};
@@ -50,23 +56,62 @@ struct JustPressCallbackAction : public ActionBase<JustPressCallbackAction> {
     void operator=(void (*callback)(void* userdata)) { this->callback = callback; }
 };
 
+#ifndef HEADLESS
 // clang-format off
 #define ACTION_FINAL(action) action.update(press_or_release, user); break;
 #define ACTION(action) action.update(press_or_release, user);
 #define KEY(key) case GLFW_KEY_##key
 #define MOUSEBUTTON(button) case GLFW_MOUSE_BUTTON_##button
 // clang-format on
+#endif
+
+// raw input with the glfwGetTime() it arrived at, queued from the GLFW callbacks to the simulation
+struct InputEvent {
+    enum Type : uint8_t {
+        KEY,
+        MOUSE_BUTTON,
+        CURSOR,
+    };
+    double time;
+    Type type;
+    bool press;
+    // GLFW key or mouse button
+    int code;
+    // CURSOR only
+    glm::vec2 screen_pos;
+    glm::vec2 world_pos;
+};
+
 struct Input {
+private:
+    // held times are counted up to here
+    double _time = 0.0;
+
+    template <class F>
+    inline void _for_each_action(F&& fn) {
+        for (Action* action : {&FORWARD, &BACKWARD, &LEFT, &RIGHT, &TURN_LEFT, &TURN_RIGHT}) { fn(*action); }
+    }
+    void _advance(const double time) {
+        if (time <= _time) return;
+        const double dt = time - _time;
+        _for_each_action([dt](Action& action) {
+            if (action.is_down()) action._held_time += dt;
+        });
+        _time = time;
+    }
+
 public:
     // ACTIONS
     JustPressCallbackAction QUIT;
     JustPressCallbackAction PRINT_HELO;
+    JustPressCallbackAction DUMP_TRACE;
     Action FORWARD;
     Action BACKWARD;
     Action LEFT;
     Action RIGHT;
     Action TURN_LEFT;
     Action TURN_RIGHT;
+#ifndef HEADLESS
     // clang-format off
     void key_cb(const int key, const bool press_or_release, const int mods, void* user) {
         // TODO: dynamic key mapping
@@ -81,6 +126,7 @@ public:
             KEY(Q): ACTION(FORWARD) ACTION_FINAL(LEFT)
             KEY(E): ACTION(FORWARD) ACTION_FINAL(RIGHT)
             KEY(ESCAPE): ACTION_FINAL(QUIT)
+            KEY(F12):    ACTION_FINAL(DUMP_TRACE)
         }
     }
     void mouse_cb(const int button, const bool press_or_release, void* user) {
@@ -91,6 +137,31 @@ public:
         }
     }
     // clang-format on
+
+    // applies an event at its timestamp, events older than the current tick count from its start
+    void apply(const InputEvent& event, void* user = nullptr) {
+        _advance(event.time);
+        switch (event.type) {
+            case InputEvent::KEY: key_cb(event.code, event.press, 0, user); break;
+            case InputEvent::MOUSE_BUTTON: mouse_cb(event.code, event.press, user); break;
+            case InputEvent::CURSOR:
+                mouse_screen_pos = event.screen_pos;
+                mouse_world_pos = event.world_pos;
+                break;
+        }
+    }
+#endif
+    // ends the tick [end - dt, end) after its events were applied: sets Action::held, JUST_ states settle
+    void end_tick(const double end, const double dt) {
+        _advance(end);
+        _for_each_action([dt](Action& action) {
+            action.held = std::min(action._held_time / dt, 1.0);
+            action._held_time = 0.0;
+            if (action.state == ActionState::JUST_PRESSED) action.state = ActionState::PRESSED;
+            if (action.state == ActionState::JUST_RELEASED) action.state = ActionState::RELEASED;
+        });
+    }
+
     glm::vec2 mouse_screen_pos{};
     glm::vec2 mouse_world_pos{};
 };
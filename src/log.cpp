@@ -1,38 +1,104 @@
 #pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+
+#include "spdlog/async.h"
+#include "spdlog/async_logger.h"
 #include "spdlog/sinks/stdout_color_sinks.h"
 #include "spdlog/spdlog.h"
 
-template <typename... T>
-inline void LTRACE(const T &...args) {
-    spdlog::trace(args...);
-}
-template <typename... T>
-inline void LDEBUG(const T &...args) {
-    spdlog::debug(args...);
-}
-template <typename... T>
-inline void LINFO(const T &...args) {
-    spdlog::info(args...);
-}
-template <typename... T>
-inline void LWARN(const T &...args) {
-    spdlog::warn(args...);
-}
-template <typename... T>
-inline void LERR(const T &...args) {
-    spdlog::error(args...);
-}
-template <typename... T>
-inline void LCRIT(const T &...args) {
-    spdlog::critical(args...);
-}
+// calls below LOG_LEVEL compile to nothing, arguments included (SPDLOG_LEVEL_TRACE = 0 .. SPDLOG_LEVEL_CRITICAL = 5).
+// release builds keep info and up, override with -DLOG_LEVEL=<n>
+#ifndef LOG_LEVEL
+#ifdef NDEBUG
+#define LOG_LEVEL SPDLOG_LEVEL_INFO
+#else
+#define LOG_LEVEL SPDLOG_LEVEL_TRACE
+#endif
+#endif
+
+// messages queued for the logging thread, the oldest are dropped when it falls behind
+constexpr size_t LOG_QUEUE_SIZE = 8192;
+
+// destroyed after _logger, so whatever is still queued gets written on exit
+inline std::shared_ptr<spdlog::details::thread_pool> _log_thread{};
+// not registered in spdlog's registry, so libraries sharing spdlog (MangoHud) cannot change its level
+inline std::shared_ptr<spdlog::logger> _logger{};
+
+// macros, so the arguments of a disabled level are not even evaluated
+#define LTRACE(...)                                                                 \
+    do {                                                                            \
+        if constexpr (LOG_LEVEL <= SPDLOG_LEVEL_TRACE) _logger->trace(__VA_ARGS__); \
+    } while (0)
+#define LDEBUG(...)                                                                 \
+    do {                                                                            \
+        if constexpr (LOG_LEVEL <= SPDLOG_LEVEL_DEBUG) _logger->debug(__VA_ARGS__); \
+    } while (0)
+#define LINFO(...)                                                                \
+    do {                                                                          \
+        if constexpr (LOG_LEVEL <= SPDLOG_LEVEL_INFO) _logger->info(__VA_ARGS__); \
+    } while (0)
+#define LWARN(...)                                                                \
+    do {                                                                          \
+        if constexpr (LOG_LEVEL <= SPDLOG_LEVEL_WARN) _logger->warn(__VA_ARGS__); \
+    } while (0)
+#define LERR(...)                                                                   \
+    do {                                                                            \
+        if constexpr (LOG_LEVEL <= SPDLOG_LEVEL_ERROR) _logger->error(__VA_ARGS__); \
+    } while (0)
+#define LCRIT(...) _logger->critical(__VA_ARGS__)
 #define LCRITRET(ret, ...)  \
     {                       \
         LCRIT(__VA_ARGS__); \
         return ret;         \
     }
+#define LERRRET(ret, ...)  \
+    {                      \
+        LERR(__VA_ARGS__); \
+        return ret;        \
+    }
+
+// one message per interval from a call site, see LEVERY()
+class LogRateLimit {
+    const int64_t _interval_ns;
+    std::atomic<int64_t> _next_ns{0};
+    std::atomic<uint32_t> _suppressed{0};
+
+public:
+    LogRateLimit(const double seconds) : _interval_ns(seconds * 1e9) {}
+    // suppressed: calls dropped since the last one that passed
+    bool pass(uint32_t &suppressed) {
+        const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        int64_t next = _next_ns.load(std::memory_order_relaxed);
+        if (now < next || !_next_ns.compare_exchange_strong(next, now + _interval_ns, std::memory_order_relaxed)) {
+            _suppressed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        suppressed = _suppressed.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+};
+// for log sites that fire every tick or frame: LEVERY(1.0, LDEBUG, "fmt", args...)
+#define LEVERY(seconds, LOG, ...)                                              \
+    do {                                                                       \
+        static LogRateLimit _log_rate_limit(seconds);                          \
+        uint32_t _log_suppressed;                                              \
+        if (_log_rate_limit.pass(_log_suppressed)) {                           \
+            LOG(__VA_ARGS__);                                                  \
+            if (_log_suppressed) LOG("({} more suppressed)", _log_suppressed); \
+        }                                                                      \
+    } while (0)
 
-inline void _init_log() {
-    spdlog::set_default_logger(spdlog::stdout_color_mt("console"));
-    spdlog::set_pattern("%^(%L%L)%$ %v");  // (DD) Debug message
+// formatting stays on the calling thread, writing and flushing happen on a background one
+inline void _init_log(const spdlog::level::level_enum level = spdlog::level::trace) {
+    _log_thread = std::make_shared<spdlog::details::thread_pool>(LOG_QUEUE_SIZE, 1);
+    _logger = std::make_shared<spdlog::async_logger>("console", std::make_shared<spdlog::sinks::stdout_color_sink_mt>(), _log_thread,
+                                                     spdlog::async_overflow_policy::overrun_oldest);
+    _logger->set_pattern("%^(%L%L)%$ %v");  // (DD) Debug message
+    _logger->set_level(level);
+    // runs on the logging thread
+    _logger->flush_on(spdlog::level::trace);
 }
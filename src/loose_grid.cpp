@@ -0,0 +1,101 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <glm/common.hpp>
+#include <glm/vec2.hpp>
+#include <unordered_map>
+#include <vector>
+
+// Uniform grid of square cells, every item lives in the one cell holding its center.
+// Cells are loose: queries grow by the largest item half extent instead of items spanning cells,
+// so moving an item is a bounds write unless its center crosses into another cell.
+// Item ids are small dense integers chosen by the caller
+class LooseGrid {
+public:
+    struct AABB {
+        glm::vec2 min, max;
+        inline bool overlaps(const AABB& other) const {
+            return min.x <= other.max.x && other.min.x <= max.x && min.y <= other.max.y && other.min.y <= max.y;
+        }
+    };
+
+private:
+    struct Item {
+        uint64_t cell;
+        // index into the cell's id list
+        uint32_t slot;
+        bool alive = false;
+        AABB bounds;
+    };
+    const float _cell_size;
+    // only grows
+    glm::vec2 _max_half_extent{};
+    std::unordered_map<uint64_t, std::vector<uint32_t>> _cells{};
+    std::vector<Item> _items{};
+    size_t _size = 0;
+
+    inline glm::ivec2 _coords(const glm::vec2& pos) const { return glm::ivec2(glm::floor(pos / _cell_size)); }
+    static inline uint64_t _key(const glm::ivec2& cell) { return uint64_t(uint32_t(cell.x)) << 32 | uint32_t(cell.y); }
+
+    void _unlink(const Item& item) {
+        std::vector<uint32_t>& ids = _cells[item.cell];
+        // swap-remove, the moved id gets its slot fixed
+        _items[ids.back()].slot = item.slot;
+        ids[item.slot] = ids.back();
+        ids.pop_back();
+        if (ids.empty()) _cells.erase(item.cell);
+    }
+
+public:
+    LooseGrid(const float cell_size) : _cell_size(cell_size) {}
+
+    // inserts or moves
+    void update(const uint32_t id, const AABB& bounds) {
+        if (id >= _items.size()) _items.resize(id + 1);
+        Item& item = _items[id];
+        _max_half_extent = glm::max(_max_half_extent, (bounds.max - bounds.min) / 2.0f);
+        const uint64_t cell = _key(_coords((bounds.min + bounds.max) / 2.0f));
+        item.bounds = bounds;
+        if (item.alive && item.cell == cell) return;
+        if (item.alive)
+            _unlink(item);
+        else
+            _size++;
+        std::vector<uint32_t>& ids = _cells[cell];
+        item.cell = cell;
+        item.slot = ids.size();
+        item.alive = true;
+        ids.push_back(id);
+    }
+    void remove(const uint32_t id) {
+        if (id >= _items.size() || !_items[id].alive) return;
+        _unlink(_items[id]);
+        _items[id].alive = false;
+        _size--;
+    }
+
+    // appends ids of items overlapping rect, in no particular order
+    void query(const AABB& rect, std::vector<uint32_t>& out) const {
+        const glm::ivec2 from = _coords(rect.min - _max_half_extent), to = _coords(rect.max + _max_half_extent);
+        // a rect covering more cells than exist is cheaper to answer by walking the cells
+        if (uint64_t(to.x - from.x + 1) * uint64_t(to.y - from.y + 1) > _cells.size()) {
+            for (const auto& [key, ids] : _cells) {
+                for (const uint32_t id : ids) {
+                    if (_items[id].bounds.overlaps(rect)) out.push_back(id);
+                }
+            }
+            return;
+        }
+        for (int x = from.x; x <= to.x; x++) {
+            for (int y = from.y; y <= to.y; y++) {
+                const auto cell = _cells.find(_key({x, y}));
+                if (cell == _cells.end()) continue;
+                for (const uint32_t id : cell->second) {
+                    if (_items[id].bounds.overlaps(rect)) out.push_back(id);
+                }
+            }
+        }
+    }
+    inline size_t size() const { return _size; }
+};
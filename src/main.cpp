@@ -13,16 +13,32 @@
 #include <spdlog/spdlog.h>
 #include <stdio.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstddef>
+#include <cstring>
+#include <thread>
 
 #include "camera.cpp"
 #include "globals.hpp"
 #include "input.cpp"
 #include "log.cpp"
+#include "loose_grid.cpp"
+#include "particles.cpp"
+#include "pool.cpp"
+#include "profiler.cpp"
+#include "replay.cpp"
 #include "resource_manager.cpp"
+#include "sectors.cpp"
 #include "ship.cpp"
 #include "sprite.cpp"
-#include "static_body.cpp"
+#include "sprite_batch.cpp"
+#include "spsc_ring.cpp"
+#include "static_geometry.cpp"
+#include "task_scheduler.cpp"
+#include "triple_buffer.cpp"
+#include "world.cpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -33,30 +49,104 @@ class UserShipController final : public Ship::IController {
 public:
     virtual void update(const Input& input) override { _cache = {input.FORWARD - input.BACKWARD, input.RIGHT - input.LEFT, input.mouse_world_pos}; }
     Ship::InputFrame get(const Ship& ship) override { return _cache; }
+    bool save_state(u_char* out) const override {
+        std::memcpy(out, &_cache, sizeof(_cache));
+        return true;
+    }
+    void load_state(const u_char* in) override { std::memcpy(&_cache, in, sizeof(_cache)); }
 };
 
 class Game {
     GLFWwindow* _window;
 
+    // main thread, polled every frame
     Input input{};
 
+    // sprites of one physics tick, passed from the simulation thread to the render thread.
+    // copied by value, entities can be despawned while the renderer still draws their last state
+    struct Snapshot {
+        struct Entry {
+            // owned by the ResourceManager
+            const Texture* texture;
+            // see Sprite::get_size()
+            glm::vec2 size;
+            Transform prev_transform;
+            Transform transform;
+        };
+        // glfwGetTime() of the tick, alpha is measured from it
+        double time = 0.0;
+        // counts publish()es
+        uint64_t sequence = 0;
+        std::vector<Entry> sprites{};
+        // index into sprites, -1 if there is no player
+        int player = -1;
+        // baked scenery, immutable and shared with the world
+        std::vector<std::shared_ptr<const StaticGeometry::Chunk>> chunks{};
+    };
+    TripleBuffer<Snapshot> _snapshots{};
+    uint64_t _published = 0;
+    std::thread _simulation{};
+    std::atomic<bool> _simulating{false};
+    // everything the GLFW callbacks saw, drained by the simulation tick by tick
+    constexpr static size_t INPUT_EVENTS = 4096;
+    SpscRing<InputEvent, INPUT_EVENTS> _events{};
+    // simulation thread, no callbacks set
+    Input _sim_input{};
+    // engine particles of every tick, emitted by the render thread
+    constexpr static size_t EXHAUST_BURSTS = 4096;
+    SpscRing<ParticleBurst, EXHAUST_BURSTS> _exhaust{};
+    // render thread: snapshot entries by the area they can be drawn in, ids are entry indices
+    constexpr static float VISIBILITY_CELL = 4.0f;
+    LooseGrid _visibility{VISIBILITY_CELL};
+    struct Indexed {
+        // never matches a real sprite, so new entries are always inserted
+        glm::vec2 size{-1.0f};
+        glm::vec2 prev_pos, pos;
+    };
+    // what every entry was indexed with, only entries that differ are moved in the grid
+    std::vector<Indexed> _indexed{};
+    uint64_t _indexed_sequence = UINT64_MAX;
+    std::vector<uint32_t> _visible{};
+    // seconds from the last cursor sample to the end of glfwSwapBuffers(), summed over the title period
+    double _input_age = 0.0;
+    double _cursor_time = 0.0;
+
 public:
-    ResourceManager resource_manager{};
+    TaskScheduler scheduler{};
+    ResourceManager resource_manager{&scheduler};
 
 private:
     Camera camera{};
-    b2WorldId world_id;
+    World world;
+    Sectors _sectors;
 
-    Sprite::_StaticDrawResources _sprite_resources;
+    SpriteBatch _sprite_batch;
+    StaticBatch _static_batch;
+    ParticleSystem _particles;
+    // glfwGetTime() of the last particles update
+    double _particles_time = 0.0;
+
+    // what a replay needs to rebuild the session, see record()
+    ReplaySetup _setup{};
+    InputRecorder _recorder{};
 
 public:
     // TODO: current_controller so it can use not only the ship but the polymorphic controller
     std::shared_ptr<IControllerBase> current_controller;
-    inline b2WorldId& get_world() { return world_id; }
+    // aimed by the cursor, its sprite is turned to the freshest cursor position when drawn
+    Pool<Ship>::Handle player{};
+    inline b2WorldId& get_world() { return world.get_id(); }
     inline static Game* _cast(void* ptr) { return static_cast<Game*>(ptr); }
     inline static Game* _get(GLFWwindow* window) { return _cast(glfwGetWindowUserPointer(window)); }
 
-    Game(GLFWwindow* window, b2WorldDef& world_def) : _window(window), world_id(b2CreateWorld(&world_def)), _sprite_resources(resource_manager) {
+    Game(GLFWwindow* window)
+        : _window(window),
+          // World::default_def(), like turned_sim --replay builds it
+          world(scheduler),
+          _sectors(world, scheduler, {resource_manager.get_texture("assets/wall01.png"), resource_manager.get_texture("assets/wall02.png")}),
+          _sprite_batch(resource_manager),
+          _static_batch(resource_manager),
+          _particles(resource_manager) {
         glfwSetWindowUserPointer(_window, this);
 
         input.QUIT = [](void* _this) {
@@ -64,13 +154,31 @@ public:
             glfwSetWindowShouldClose(_cast(_this)->_window, GLFW_TRUE);
         };
         input.PRINT_HELO = [](void* _this) { LINFO("HELO!!"); };
+        input.DUMP_TRACE = [](void* _this) { PROFILE_DUMP(); };
 
         glfwSetKeyCallback(_window, [](GLFWwindow* w, int key, int scancode, int action, int mods) {
             if (action == GLFW_REPEAT) return;
             _get(w)->input.key_cb(key, action == GLFW_PRESS, mods, _get(w));
+            _get(w)->_push_event({glfwGetTime(), InputEvent::KEY, action == GLFW_PRESS, key});
+        });
+        glfwSetMouseButtonCallback(_window, [](GLFWwindow* w, int button, int action, int mods) {
+            _get(w)->input.mouse_cb(button, action == GLFW_PRESS, _get(w));
+            _get(w)->_push_event({glfwGetTime(), InputEvent::MOUSE_BUTTON, action == GLFW_PRESS, button});
+        });
+        glfwSetCursorPosCallback(_window, [](GLFWwindow* w, double x, double y) {
+            Game* game = _get(w);
+            const glm::vec2 screen_pos(x, y);
+            game->_push_event({glfwGetTime(), InputEvent::CURSOR, false, 0, screen_pos, game->_screen_to_world(screen_pos)});
         });
-        glfwSetMouseButtonCallback(_window,
-                                   [](GLFWwindow* w, int button, int action, int mods) { _get(w)->input.mouse_cb(button, action == GLFW_PRESS, _get(w)); });
+
+        // the ships and the sectors in reach fit without growing the pools
+        world.ships.reserve(256);
+        world.chunks.reserve((2 * SECTOR_UNLOAD_RADIUS + 1) * (2 * SECTOR_UNLOAD_RADIUS + 1));
+        // material 0, see Ship::exhaust_material
+        ParticleSystem::Material exhaust{};
+        exhaust.capacity = 1 << 17;
+        _particles.add_material(exhaust);
+        world.emit_exhaust = true;
 
         glEnable(GL_BLEND);
         preload = resource_manager.get_texture("assets/ship01.png");
@@ -79,48 +187,215 @@ public:
 
     GLFWwindow* get_window() const { return _window; }
 
-    inline void process_input() {
-        glfwPollEvents();
+    // before start_simulation(), the world belongs to the simulation thread afterwards
+    void spawn_player(const Transform& transform) {
+        _setup.player = {{transform.pos.x, transform.pos.y}, transform.rot};
+        player = world.spawn_ship(resource_manager.get_texture("assets/ship01.png"), transform);
+        Ship* ship = world.ships.get(player);
+        ship->controller = std::make_shared<UserShipController>();
+        current_controller = ship->controller;
+    }
+
+    // after spawn_player(), before start_simulation(). Writes the player's input of every tick to path, for turned_sim --replay
+    bool record(const char* path) {
+        Ship* ship = world.ships.get(player);
+        if (!ship) LERRRET(false, "no player to record");
+        _setup.seed = _sectors.seed();
+        _setup.far_radius = world.far_radius;
+        _setup.dt = PHYSICS_DT;
+        const std::shared_ptr<Ship::IController> recorded = _recorder.add(ship->controller);
+        if (!_recorder.open(path, _setup)) return false;
+        ship->controller = recorded;
+        _sectors.lockstep = true;
+        return true;
+    }
 
+    inline glm::vec2 _screen_to_world(const glm::vec2& screen_pos) const {
+        glm::vec2 out = camera.pos / float(ZOOM_FACTOR) - camera.get_dimensions() / 2.0f + screen_pos / float(ZOOM_FACTOR);
+        out.y = -out.y;
+        return out;
+    }
+    inline void _push_event(const InputEvent& event) {
+        if (!_events.push(event)) LEVERY(1.0, LWARN, "input queue is full, dropping events");
+    }
+    // samples the cursor now, main thread only
+    inline void _read_cursor() {
         double mousex, mousey;
         glfwGetCursorPos(_window, &mousex, &mousey);
+        _cursor_time = glfwGetTime();
         input.mouse_screen_pos = glm::vec2(mousex, mousey);
-        input.mouse_world_pos = (camera.pos / float(ZOOM_FACTOR) - camera.get_dimensions() / 2.0f + glm::vec2(mousex, mousey) / float(ZOOM_FACTOR));
-        input.mouse_world_pos.y = -input.mouse_world_pos.y;
+        input.mouse_world_pos = _screen_to_world(input.mouse_screen_pos);
+    }
+
+    // callbacks run in here and queue their events for the simulation
+    inline void process_input() {
+        PROFILE_ZONE("process_input");
+        glfwPollEvents();
+    }
+
+    // simulation thread. Applies the input events of the tick [tick_end - delta, tick_end), later ones wait for the next tick
+    inline void process_physics(const double& delta, const double tick_end) {
+        PROFILE_ZONE("process_physics");
+        for (const InputEvent* event = _events.peek(); event && event->time < tick_end; event = _events.peek()) {
+            _sim_input.apply(*event);
+            _events.pop();
+        }
+        _sim_input.end_tick(tick_end, delta);
+        if (current_controller) current_controller->update(_sim_input);
+        if (const Ship* ship = world.ships.get(player)) world.focus = ship->get_transform().pos;
+        _sectors.update(world.focus);
+        world.step(delta);
+        _recorder.end_tick();
+        for (const ParticleBurst& burst : world.exhaust) {
+            if (_exhaust.push(burst)) continue;
+            LEVERY(1.0, LDEBUG, "exhaust queue is full, dropping particles");
+            break;
+        }
+        world.exhaust.clear();
+    }
+    void _publish(const double time) {
+        Snapshot& snapshot = _snapshots.write();
+        snapshot.time = time;
+        snapshot.sequence = _published++;
+        snapshot.player = -1;
+        snapshot.sprites.clear();
+        for (auto it = world.ships.begin(); it != world.ships.end(); ++it) {
+            if (it.handle() == player) snapshot.player = snapshot.sprites.size();
+            const Sprite& sprite = it->get_sprite();
+            snapshot.sprites.push_back({sprite.get_texture(), sprite.get_size(), sprite.prev_transform, sprite.transform});
+        }
+        snapshot.chunks.clear();
+        for (const StaticChunk& chunk : world.chunks) {
+            // the other chunks of a sector only add shapes
+            if (chunk.geometry) snapshot.chunks.push_back(chunk.geometry);
+        }
+        _snapshots.publish();
+    }
+    // fixed rate physics, publishes a snapshot after every batch of ticks
+    void _simulation_loop() {
+        // b2World_Step now waits on its tasks from this thread
+        scheduler.make_owner();
+        double next_tick = glfwGetTime();
+        while (_simulating.load(std::memory_order_relaxed)) {
+            const double now = glfwGetTime();
+            if (now < next_tick) {
+                std::this_thread::sleep_for(std::chrono::duration<double>(next_tick - now));
+                continue;
+            }
+            int steps = 0;
+            for (; now >= next_tick && steps < MAX_PHYSICS_STEPS_PER_FRAME; steps++) {
+                process_physics(PHYSICS_DT, next_tick);
+                next_tick += PHYSICS_DT;
+            }
+            if (now >= next_tick) {
+                LEVERY(1.0, LDEBUG, "physics is {:.1f} ticks behind, dropping them", (now - next_tick) / PHYSICS_DT);
+                next_tick = now + PHYSICS_DT - std::fmod(now - next_tick, PHYSICS_DT);
+            }
+            _publish(next_tick - PHYSICS_DT);
+        }
+    }
+    // everything added to the world from here on must go through the simulation thread
+    void start_simulation() {
+        _publish(glfwGetTime());
+        _simulating = true;
+        _simulation = std::thread(&Game::_simulation_loop, this);
+    }
+    void stop_simulation() {
+        _simulating = false;
+        if (_simulation.joinable()) _simulation.join();
+        scheduler.make_owner();
+        _recorder.close(world);
+    }
 
-        if (current_controller) current_controller->update(input);
+    void _update_visibility(const Snapshot& snapshot) {
+        if (snapshot.sequence == _indexed_sequence) return;
+        PROFILE_ZONE("Game::_update_visibility");
+        _indexed_sequence = snapshot.sequence;
+        for (size_t i = snapshot.sprites.size(); i < _indexed.size(); i++) { _visibility.remove(i); }
+        _indexed.resize(snapshot.sprites.size());
+        for (size_t i = 0; i < snapshot.sprites.size(); i++) {
+            const Snapshot::Entry& entry = snapshot.sprites[i];
+            Indexed& indexed = _indexed[i];
+            if (indexed.size == entry.size && indexed.pos == entry.transform.pos && indexed.prev_pos == entry.prev_transform.pos) continue;
+            indexed = {entry.size, entry.prev_transform.pos, entry.transform.pos};
+            // bounding circle of any rotation, swept over the interpolated path
+            const float radius = glm::length(entry.size) / 2.0f;
+            _visibility.update(i, {glm::min(indexed.prev_pos, indexed.pos) - radius, glm::max(indexed.prev_pos, indexed.pos) + radius});
+        }
     }
-    inline void process_physics(const double& delta) {
-        b2World_Step(world_id, delta, PHYSICS_SUBSTEPS_COUNT);
-        for (Ship* ship : ships) { ship->physics(delta); }
+
+    void _update_particles() {
+        for (const ParticleBurst* burst = _exhaust.peek(); burst; burst = _exhaust.peek()) {
+            _particles.emit(*burst);
+            _exhaust.pop();
+        }
+        const double now = glfwGetTime();
+        // a long stall would fade everything at once anyway
+        _particles.update(std::min(now - _particles_time, 0.25), &scheduler);
+        _particles_time = now;
     }
+
+    // interpolates the visible part of the newest snapshot, the player ship is turned to the cursor sampled right before drawing
     inline void draw() {
-        spdlog::default_logger()->flush();
-        Sprite::predraw(_sprite_resources);
-        for (const Sprite* sprite : sprites) { sprite->draw(_sprite_resources, camera.get_view_projection()); }
+        PROFILE_ZONE("draw");
+        PROFILE_GPU_ZONE("draw");
+        resource_manager.pump_uploads();
+        const Snapshot& snapshot = _snapshots.read();
+        _update_visibility(snapshot);
+        LooseGrid::AABB view;
+        camera.get_visible_rect(view.min, view.max);
+        _visible.clear();
+        _visibility.query(view, _visible);
+        // keeps the order of the snapshot
+        std::sort(_visible.begin(), _visible.end());
+
+        const float alpha = std::clamp((glfwGetTime() - snapshot.time) / PHYSICS_DT, 0.0, 1.0);
+        _static_batch.draw(snapshot.chunks, camera.get_view_projection(), view.min, view.max);
+        _update_particles();
+        _particles.draw(camera.get_view_projection());
+        _read_cursor();
+        _sprite_batch.begin();
+        for (const uint32_t i : _visible) {
+            const Snapshot::Entry& entry = snapshot.sprites[i];
+            Transform transform = Transform::lerp(entry.prev_transform, entry.transform, alpha);
+            if (int(i) == snapshot.player) Ship::look_at(transform.pos, input.mouse_world_pos, transform.rot);
+            _sprite_batch.submit(*entry.texture, entry.size, transform);
+        }
+        _sprite_batch.draw(camera.get_view_projection());
+    }
+    inline void frame_presented() { _input_age += glfwGetTime() - _cursor_time; }
+    // mean input_age of the frames since the last call, milliseconds
+    inline double take_input_age(const uint frames) {
+        const double out = frames ? _input_age / frames * 1000.0 : 0.0;
+        _input_age = 0.0;
+        return out;
     }
 #ifdef DRAW_DEBUG
     inline void debug_draw() {
-        spdlog::default_logger()->flush();
-        Sprite::predraw_debug(_sprite_resources);
-        for (const Sprite* sprite : sprites) { sprite->draw_debug(_sprite_resources, camera.get_view_projection()); }
+        PROFILE_ZONE("debug_draw");
+        PROFILE_GPU_ZONE("debug_draw");
+        _sprite_batch.draw_debug(camera.get_view_projection());
     }
 #endif
-
-    std::vector<Ship*> ships{};
-    // TODO: associating sprites with Texture for using Sprite::predraw() only once per frame
-    std::vector<const Sprite*> sprites{};
+    inline const SpriteBatch::Stats& get_draw_stats() const { return _sprite_batch.stats(); }
+    inline const ParticleSystem::Stats& get_particle_stats() const { return _particles.stats(); }
+    inline const StaticBatch::Stats& get_static_stats() const { return _static_batch.stats(); }
+    struct VisibilityStats {
+        size_t visible;
+        size_t total;
+    };
+    // of the last draw()
+    inline VisibilityStats get_visibility_stats() const { return {_visible.size(), _visibility.size()}; }
 
     inline void _set_viewport_dimensions(const uint w, const uint h) {
         camera.set_dimensions(w, h);
         glViewport(0, 0, w, h);
     }
 };
-int main() {
+int main(int argc, char** argv) {
     std::filesystem::current_path(std::filesystem::canonical("/proc/self/exe").parent_path());
-    LINFO(std::filesystem::current_path().c_str());
     _init_log();
-    spdlog::set_level(spdlog::level::trace);
+    LINFO(std::filesystem::current_path().c_str());
 
     LDEBUG("{}", PROJECT_NAME_VERSION);
     if (!glfwInit()) LCRITRET(1, "!glfwInit()");
@@ -130,30 +405,17 @@ int main() {
     glfwWindowHintString(GLFW_X11_INSTANCE_NAME, "turned");
     GLFWwindow* window = glfwCreateWindow(640, 640, PROJECT_NAME_VERSION, NULL, NULL);
     if (!window) LCRITRET(1, "!window");
-    b2WorldDef world_def = b2DefaultWorldDef();
-    world_def.gravity = {0.0f, 0.0f};
-    world_def.enableContinuous = true;
-    world_def.enableContactSoftening = true;
     glfwMakeContextCurrent(window);
-    // MangoHud sets its own log level, so we overwrite it
-    spdlog::set_level(spdlog::level::trace);
-
-    Game* game = new Game(window, world_def);
-
-    Ship player_ship = Ship(game->resource_manager.get_texture("assets/ship01.png"), game->get_world(), Transform({0.0f, 0.0f}, 0.0));
-    game->ships.push_back(&player_ship);
-    player_ship.controller = std::make_shared<UserShipController>();
-    game->current_controller = player_ship.controller;
-
-    std::array<StaticBody, 4> walls = {
-        StaticBody::construct_box_from_texture(game->resource_manager.get_texture("assets/wall02.png"), game->get_world(), Transform({0.0, -(256.0)}, 0.0)),
-        StaticBody::construct_box_from_texture(game->resource_manager.get_texture("assets/wall02.png"), game->get_world(), Transform({0.0, (256.0)}, 0.0)),
-        StaticBody::construct_box_from_texture(game->resource_manager.get_texture("assets/wall02.png"), game->get_world(),
-                                               Transform({-(256.0), 0.0}, glm::radians(90.0))),
-        StaticBody::construct_box_from_texture(game->resource_manager.get_texture("assets/wall02.png"), game->get_world(),
-                                               Transform({(256.0), 0.0}, glm::radians(90.0)))};
-    for (auto&& wall : walls) { game->sprites.push_back(&wall.sprite); }
-    game->sprites.push_back(&game->ships[0]->get_sprite());
+
+    Game* game = new Game(window);
+
+    game->spawn_player(Transform({0.0f, 0.0f}, 0.0));
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--record") && i + 1 < argc) {
+            if (!game->record(argv[++i])) LCRITRET(1, "failed to start recording");
+        } else
+            LWARN("unknown option {}", argv[i]);
+    }
 
     {
         int w, h;
@@ -163,23 +425,42 @@ int main() {
     glfwSetFramebufferSizeCallback(window, [](GLFWwindow* win, int w, int h) { Game::_get(win)->_set_viewport_dimensions(w, h); });
     glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
     glfwSwapInterval(0);
-    double now = glfwGetTime(), last_frame = now, frame_delta = 0;
-    Timer physics_timer{last_frame};
+    double now = glfwGetTime();
+    Timer title_timer{now};
+    uint frames = 0;
+    game->start_simulation();
     while (!glfwWindowShouldClose(window)) {
+        PROFILE_ZONE("frame");
         now = glfwGetTime();
         glClear(GL_COLOR_BUFFER_BIT);
         game->process_input();
-        if (physics_timer.is_expired(now)) {
-            physics_timer.set_target(now + 1.0 / PHYSICS_RATE);
-            game->process_physics(1.0 / PHYSICS_RATE);
-        }
         game->draw();
 #ifdef DRAW_DEBUG
         game->debug_draw();
 #endif
-        glfwSwapBuffers(window);
-        frame_delta = now - last_frame;
-        last_frame = now;
+        {
+            PROFILE_ZONE("glfwSwapBuffers");
+            glfwSwapBuffers(window);
+        }
+        game->frame_presented();
+        PROFILE_GPU_COLLECT();
+        frames++;
+        if (title_timer.is_expired(now)) {
+            title_timer.set_target(now + 1.0);
+            const SpriteBatch::Stats& stats = game->get_draw_stats();
+            const Game::VisibilityStats visibility = game->get_visibility_stats();
+            const ParticleSystem::Stats& particles = game->get_particle_stats();
+            const StaticBatch::Stats& statics = game->get_static_stats();
+            const std::string title =
+                fmt::format("{} | {} fps | {}/{} sprites visible | {} particles | {} draw calls | aim {:.1f} ms", PROJECT_NAME_VERSION, frames, visibility.visible,
+                            visibility.total, particles.live, stats.draw_calls + particles.draw_calls + statics.draw_calls, game->take_input_age(frames));
+            glfwSetWindowTitle(window, title.c_str());
+            frames = 0;
+        }
     }
+    game->stop_simulation();
+    const ResourceManager::Stats& resources = game->resource_manager.stats();
+    LDEBUG("resources: {} lookups, {} loads, {} duplicate loads", resources.lookups, resources.loads, resources.duplicate_loads);
+    PROFILE_DUMP();
     glfwDestroyWindow(window);
 }
@@ -1,8 +1,11 @@
 #pragma once
 #include <sys/types.h>
+#ifndef HEADLESS
 #define GL_GLEXT_PROTOTYPES
 #include <GL/gl.h>
+#endif
 
+#include <cstddef>
 #include <glm/vec2.hpp>
 struct Vertex {
     glm::vec2 pos;
@@ -10,7 +13,9 @@ struct Vertex {
 };
 class Mesh {
 protected:
+#ifndef HEADLESS
     uint _VAO, _VBO, _EBO;
+#endif
     const size_t _nindices;
 
 public:
@@ -18,6 +23,7 @@ public:
     Mesh(const Mesh&) = delete;
     Mesh& operator=(const Mesh&) = delete;
     Mesh(const Vertex* vertices, const size_t nvertices, const uint* indices, const size_t nindices) : _nindices(nindices) {
+#ifndef HEADLESS
         glGenVertexArrays(1, &_VAO);
         glGenBuffers(1, &_VBO);
         glGenBuffers(1, &_EBO);
@@ -36,11 +42,23 @@ public:
         glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, texture)));
 
         glBindVertexArray(0);
+#endif
+    }
+
+#ifndef HEADLESS
+    ~Mesh() {
+        glDeleteVertexArrays(1, &_VAO);
+        glDeleteBuffers(1, &_VBO);
+        glDeleteBuffers(1, &_EBO);
     }
 
     inline void use() { glBindVertexArray(_VAO); }
     inline void draw() const { glDrawElements(GL_TRIANGLES, _nindices, GL_UNSIGNED_INT, 0); }
+    inline void draw_instanced(const size_t ninstances) const { glDrawElementsInstanced(GL_TRIANGLES, _nindices, GL_UNSIGNED_INT, 0, ninstances); }
 #ifdef DRAW_DEBUG
     inline void draw_lines() const { glDrawElements(GL_LINE_LOOP, _nindices, GL_UNSIGNED_INT, 0); }
+    inline void draw_lines_instanced(const size_t ninstances) const { glDrawElementsInstanced(GL_LINE_LOOP, _nindices, GL_UNSIGNED_INT, 0, ninstances); }
+#endif
 #endif
+    inline size_t nindices() const { return _nindices; }
 };
@@ -0,0 +1,294 @@
+#pragma once
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <glm/gtc/constants.hpp>
+#include <glm/vec2.hpp>
+#include <vector>
+
+#include "log.cpp"
+#include "ship.cpp"
+#include "transform.cpp"
+
+// non-blocking IPv4 UDP socket
+class UdpSocket {
+    int _fd = -1;
+
+public:
+    UdpSocket() = default;
+    UdpSocket(const UdpSocket&) = delete;
+    UdpSocket& operator=(const UdpSocket&) = delete;
+    ~UdpSocket() { close(); }
+
+    // port 0 picks a free one, see port()
+    bool open(const uint16_t port = 0, const char* address = "127.0.0.1") {
+        close();
+        _fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+        if (_fd < 0) LERRRET(false, "socket(): {}", std::strerror(errno));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        if (inet_pton(AF_INET, address, &addr.sin_addr) != 1) LERRRET(false, "bad address {}", address);
+        if (::bind(_fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr))) LERRRET(false, "bind({}:{}): {}", address, port, std::strerror(errno));
+        fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL) | O_NONBLOCK);
+        // a tick of snapshots for every client fits without drops
+        const int buffer = 4 << 20;
+        setsockopt(_fd, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+        setsockopt(_fd, SOL_SOCKET, SO_SNDBUF, &buffer, sizeof(buffer));
+        return true;
+    }
+    void close() {
+        if (_fd >= 0) ::close(_fd);
+        _fd = -1;
+    }
+    uint16_t port() const {
+        sockaddr_in addr{};
+        socklen_t len = sizeof(addr);
+        getsockname(_fd, reinterpret_cast<sockaddr*>(&addr), &len);
+        return ntohs(addr.sin_port);
+    }
+
+    inline bool send(const sockaddr_in& to, const void* data, const size_t size) {
+        return ::sendto(_fd, data, size, 0, reinterpret_cast<const sockaddr*>(&to), sizeof(to)) == ssize_t(size);
+    }
+    // bytes received, 0 if nothing is waiting
+    inline size_t receive(sockaddr_in& from, void* data, const size_t capacity) {
+        socklen_t len = sizeof(from);
+        const ssize_t size = ::recvfrom(_fd, data, capacity, 0, reinterpret_cast<sockaddr*>(&from), &len);
+        return size > 0 ? size : 0;
+    }
+};
+
+inline bool operator==(const sockaddr_in& a, const sockaddr_in& b) { return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port; }
+
+// appends to a fixed buffer, writes past the end are dropped and flagged
+class ByteWriter {
+    u_char* _data;
+    size_t _capacity;
+    size_t _size = 0;
+    bool _overflow = false;
+
+public:
+    ByteWriter(u_char* data, const size_t capacity) : _data(data), _capacity(capacity) {}
+
+    template <class T>
+    inline void put(const T& value) {
+        if (_capacity - _size < sizeof(T)) {
+            _overflow = true;
+            return;
+        }
+        std::memcpy(_data + _size, &value, sizeof(T));
+        _size += sizeof(T);
+    }
+    inline void put_varint(uint32_t value) {
+        for (; value >= 0x80; value >>= 7) { put(uint8_t(value | 0x80)); }
+        put(uint8_t(value));
+    }
+    // small magnitudes of either sign in few bytes
+    inline void put_zigzag(const int32_t value) { put_varint(zigzag(value)); }
+
+    static inline uint32_t zigzag(const int32_t value) { return (uint32_t(value) << 1) ^ uint32_t(value >> 31); }
+    static inline size_t varint_size(const uint32_t value) { return value < 1u << 7 ? 1 : value < 1u << 14 ? 2 : value < 1u << 21 ? 3 : value < 1u << 28 ? 4 : 5; }
+
+    inline size_t size() const { return _size; }
+    inline bool overflow() const { return _overflow; }
+};
+
+class ByteReader {
+    const u_char* _data;
+    size_t _size;
+    size_t _at = 0;
+    bool _error = false;
+
+public:
+    ByteReader(const u_char* data, const size_t size) : _data(data), _size(size) {}
+
+    template <class T>
+    inline T get() {
+        T out{};
+        if (_size - _at < sizeof(T)) {
+            _error = true;
+            return out;
+        }
+        std::memcpy(&out, _data + _at, sizeof(T));
+        _at += sizeof(T);
+        return out;
+    }
+    inline uint32_t get_varint() {
+        uint32_t out = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            const uint8_t byte = get<uint8_t>();
+            out |= uint32_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return out;
+        }
+        _error = true;
+        return out;
+    }
+    inline int32_t get_zigzag() {
+        const uint32_t value = get_varint();
+        return int32_t(value >> 1) ^ -int32_t(value & 1);
+    }
+    // true if anything was read past the end
+    inline bool error() const { return _error; }
+};
+
+// Client/server protocol, native endianness, one message per datagram:
+//   client: HELLO, then INPUT every tick
+//   server: WELCOME, then SNAPSHOT every tick
+// Snapshots are deltas of a NetView against the newest one the client acknowledged in INPUT
+struct NetProtocol {
+    constexpr static uint16_t MAGIC = 0x5475;
+    // payload, below a typical path MTU
+    constexpr static size_t MAX_PACKET = 1200;
+    constexpr static uint32_t NO_TICK = UINT32_MAX;
+    // views remembered on both ends, acks older than this fall back to full snapshots
+    constexpr static uint32_t HISTORY = 32;
+    // positions: physics units * POS_SCALE, rounded
+    constexpr static float POS_SCALE = 128.0f;
+    // pool indices in a snapshot stay below this, snapshots with larger ones are corrupt
+    constexpr static uint32_t MAX_SHIPS = 1 << 16;
+
+    enum Type : uint8_t {
+        HELLO,
+        // uint32 ship index
+        WELCOME,
+        // uint32 newest snapshot tick decoded, float throttle, slide, lookat.x, lookat.y
+        INPUT,
+        // uint32 tick, uint32 baseline tick or NO_TICK, varint count, entries
+        SNAPSHOT,
+    };
+    // low bits of each entry's varint, above them the index delta to the previous entry
+    enum Entry : uint8_t {
+        // zigzag dx, dy, dangle
+        DELTA,
+        // varint generation, zigzag x, y, uint16 angle
+        FULL,
+        REMOVED,
+    };
+
+    // a ship as the client sees it
+    struct Quantized {
+        // 0 = no ship at this index
+        uint32_t generation;
+        int32_t x, y;
+        uint16_t angle;
+
+        inline bool operator==(const Quantized& other) const {
+            return generation == other.generation && x == other.x && y == other.y && angle == other.angle;
+        }
+        inline bool operator!=(const Quantized& other) const { return !(*this == other); }
+    };
+    static inline Quantized quantize(const uint32_t generation, const Transform& transform) {
+        const float angle = std::atan2(transform.rot.s, transform.rot.c);
+        return {generation, int32_t(std::lround(transform.pos.x * POS_SCALE)), int32_t(std::lround(transform.pos.y * POS_SCALE)),
+                uint16_t(int32_t(std::lround(angle * (65536.0f / glm::two_pi<float>()))))};
+    }
+    static inline Transform dequantize(const Quantized& q) {
+        return Transform(glm::vec2(q.x, q.y) / POS_SCALE, double(q.angle) * (glm::two_pi<double>() / 65536.0));
+    }
+
+    static inline void put_header(ByteWriter& out, const Type type) {
+        out.put(MAGIC);
+        out.put(type);
+    }
+    // false if it is not ours
+    static inline bool get_header(ByteReader& in, Type& type) {
+        if (in.get<uint16_t>() != MAGIC) return false;
+        type = in.get<Type>();
+        return !in.error();
+    }
+};
+
+// what one client knows about every ship at one tick, by pool index. Kept for the last HISTORY ticks on both ends,
+// so a snapshot and its baseline decode into the same view on the client as on the server
+struct NetView {
+    uint32_t tick = NetProtocol::NO_TICK;
+    std::vector<NetProtocol::Quantized> ships{};
+
+    inline void set(const uint32_t index, const NetProtocol::Quantized& q) {
+        if (index >= ships.size()) ships.resize(index + 1, {});
+        ships[index] = q;
+    }
+    inline const NetProtocol::Quantized* get(const uint32_t index) const { return index < ships.size() && ships[index].generation ? &ships[index] : nullptr; }
+};
+
+// the views of the last NetProtocol::HISTORY ticks
+class NetHistory {
+    std::array<NetView, NetProtocol::HISTORY> _views{};
+
+public:
+    // nullptr if tick is no longer (or never was) kept
+    inline const NetView* find(const uint32_t tick) const {
+        if (tick == NetProtocol::NO_TICK) return nullptr;
+        const NetView& view = _views[tick % NetProtocol::HISTORY];
+        return view.tick == tick ? &view : nullptr;
+    }
+    // starts the view of tick as a copy of baseline (empty if nullptr), reusing the slot's storage
+    inline NetView& begin(const uint32_t tick, const NetView* baseline) {
+        NetView& view = _views[tick % NetProtocol::HISTORY];
+        view.tick = tick;
+        if (baseline)
+            view.ships.assign(baseline->ships.begin(), baseline->ships.end());
+        else
+            view.ships.clear();
+        return view;
+    }
+};
+
+// client side of SNAPSHOT: decodes into the history, false if the packet is corrupt or its baseline is gone
+inline bool read_snapshot(ByteReader& in, NetHistory& history, uint32_t& tick) {
+    tick = in.get<uint32_t>();
+    const uint32_t baseline_tick = in.get<uint32_t>();
+    const uint32_t count = in.get_varint();
+    // indices only grow, there can not be more entries than ships
+    if (in.error() || count > NetProtocol::MAX_SHIPS) return false;
+    const NetView* baseline = history.find(baseline_tick);
+    if (baseline_tick != NetProtocol::NO_TICK && !baseline) return false;
+    // a copy, the new view may take the baseline's slot
+    NetView view = baseline ? *baseline : NetView{};
+    uint32_t index = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const uint32_t head = in.get_varint();
+        if (in.error()) return false;
+        // index is below MAX_SHIPS after the first entry, so neither the sum nor the difference wraps
+        const uint32_t step = (head >> 2) + (i ? 1 : 0);
+        if (step >= NetProtocol::MAX_SHIPS - index) return false;
+        index += step;
+        switch (head & 3) {
+            case NetProtocol::DELTA: {
+                const NetProtocol::Quantized* prev = view.get(index);
+                if (!prev) return false;
+                NetProtocol::Quantized q = *prev;
+                q.x += in.get_zigzag();
+                q.y += in.get_zigzag();
+                q.angle += uint16_t(in.get_zigzag());
+                view.set(index, q);
+                break;
+            }
+            case NetProtocol::FULL: {
+                NetProtocol::Quantized q{};
+                q.generation = in.get_varint();
+                q.x = in.get_zigzag();
+                q.y = in.get_zigzag();
+                q.angle = in.get<uint16_t>();
+                view.set(index, q);
+                break;
+            }
+            case NetProtocol::REMOVED: view.set(index, {}); break;
+            default: return false;
+        }
+    }
+    if (in.error()) return false;
+    NetView& out = history.begin(tick, nullptr);
+    out.ships.swap(view.ships);
+    return true;
+}
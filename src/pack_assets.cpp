@@ -0,0 +1,78 @@
+// offline asset baker: decodes images once and writes them GL-ready into an AssetPack.
+//   pack_assets <out.pack> <image>...
+// image paths are stored lexically normalized like ResourceManager looks them up,
+// so run it from the directory the game resolves "assets/..." against
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#include "asset_pack.cpp"
+#include "atlas.cpp"
+#include "hash.hpp"
+#include "log.cpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+struct Baked {
+    AssetPack::Entry entry;
+    const char* path;
+    std::vector<u_char> pixels;
+};
+
+int main(int argc, char** argv) {
+    _init_log(spdlog::level::info);
+    if (argc < 2) LCRITRET(1, "usage: {} <out.pack> <image>...", argv[0]);
+    const char* out_path = argv[1];
+
+    std::vector<Baked> baked{};
+    stbi_set_flip_vertically_on_load(true);
+    for (int i = 2; i < argc; i++) {
+        int w, h, nchannels;
+        // always RGBA, like ResourceManager
+        u_char* data = stbi_load(argv[i], &w, &h, &nchannels, 4);
+        if (!data) LCRITRET(1, "failed to load texture {}: {}", argv[i], stbi_failure_reason());
+        const std::string normal = std::filesystem::path(argv[i]).lexically_normal().string();
+        Baked out{{fnv1a(normal), 0, uint32_t(w), uint32_t(h), TextureAtlas::PADDING, 1}, argv[i]};
+        out.pixels.resize(TextureAtlas::padded_size(w, h));
+        TextureAtlas::extrude(data, w, h, out.pixels.data());
+        stbi_image_free(data);
+        baked.push_back(std::move(out));
+    }
+    std::sort(baked.begin(), baked.end(), [](const Baked& a, const Baked& b) { return a.entry.id < b.entry.id; });
+    for (size_t i = 1; i < baked.size(); i++) {
+        if (baked[i].entry.id == baked[i - 1].entry.id) LCRITRET(1, "{} and {} hash to the same id", baked[i - 1].path, baked[i].path);
+    }
+
+    // pixels after the table of contents, each aligned
+    uint64_t offset = sizeof(AssetPack::Header) + baked.size() * sizeof(AssetPack::Entry);
+    for (Baked& b : baked) {
+        offset = (offset + AssetPack::ENTRY_ALIGN - 1) / AssetPack::ENTRY_ALIGN * AssetPack::ENTRY_ALIGN;
+        b.entry.offset = offset;
+        offset += b.pixels.size();
+    }
+
+    FILE* file = std::fopen(out_path, "wb");
+    if (!file) LCRITRET(1, "failed to open {}: {}", out_path, std::strerror(errno));
+    AssetPack::Header header{};
+    std::memcpy(header.magic, AssetPack::MAGIC, sizeof(header.magic));
+    header.version = AssetPack::VERSION;
+    header.count = baked.size();
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    for (const Baked& b : baked) { ok = ok && std::fwrite(&b.entry, sizeof(b.entry), 1, file) == 1; }
+    const u_char zeros[AssetPack::ENTRY_ALIGN]{};
+    for (const Baked& b : baked) {
+        const long gap = long(b.entry.offset) - std::ftell(file);
+        ok = ok && std::fwrite(zeros, 1, gap, file) == size_t(gap);
+        ok = ok && std::fwrite(b.pixels.data(), 1, b.pixels.size(), file) == b.pixels.size();
+        LINFO("{}: {}x{}", b.path, b.entry.w, b.entry.h);
+    }
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok) LCRITRET(1, "failed to write {}", out_path);
+    LINFO("{}: {} textures, {} bytes", out_path, baked.size(), offset);
+    return 0;
+}
@@ -0,0 +1,308 @@
+#pragma once
+#ifndef HEADLESS
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#endif
+#include <sys/types.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+#include <memory>
+#include <vector>
+
+#include "log.cpp"
+#include "profiler.cpp"
+#include "simd.cpp"
+#include "task_scheduler.cpp"
+#ifndef HEADLESS
+#include "resource_manager.cpp"
+#include "shader.cpp"
+#include "shaders.hpp"
+#endif
+
+// particles to throw out of a moving point, made by the simulation (see Ship::physics()) and handed to ParticleSystem::emit()
+struct ParticleBurst {
+    // physics units, where the emitter is at the end of dt
+    glm::vec2 pos;
+    // of the emitter, physics units per second. Particles are spread over the path it moved during dt
+    glm::vec2 vel;
+    // unit vector particles are thrown at, relative to the emitter
+    glm::vec2 dir;
+    // physics units per second, jittered by a quarter
+    float speed;
+    // half angle of the cone around dir, radians, up to about 1
+    float spread;
+    // seconds
+    float dt;
+    uint16_t count;
+    // see ParticleSystem::add_material()
+    uint8_t material;
+};
+
+// Exhaust, impacts and debris. Every material keeps its particles in a fixed-capacity ring of SoA arrays:
+// all of them live equally long, so they die in the order they were born and the live ones stay contiguous.
+// emit(), update() and fade run f32x4::N particles per instruction, update() spreads large rings over the scheduler.
+// draw() is one GL_POINTS call per material straight from the SoA arrays.
+// Headless builds keep only the CPU side, for benchmarks
+class ParticleSystem {
+public:
+    struct Material {
+        // seconds
+        float life = 0.5f;
+        // fraction of the velocity lost per second
+        float drag = 2.0f;
+        // diameter at death and at birth, physics units
+        glm::vec2 size{0.05f, 0.2f};
+        // alpha is scaled by what is left of the life
+        glm::vec4 color{1.0f, 0.6f, 0.2f, 1.0f};
+        // live particles, the oldest ones make room when it is full
+        uint32_t capacity = 1 << 16;
+    };
+    struct Stats {
+        uint live = 0;
+        uint draw_calls = 0;
+    };
+
+private:
+    // live particles are [tail, tail + count) modulo capacity
+    struct _Ring {
+        Material material;
+        std::vector<float> x, y, vx, vy;
+        // 1 at birth, 0 at death
+        std::vector<float> fade;
+        uint32_t tail = 0;
+        uint32_t count = 0;
+#ifndef HEADLESS
+        // x, y and fade of the live particles, oldest first, one after another
+        uint VAO, VBO;
+#endif
+    };
+
+    std::vector<_Ring> _rings{};
+    uint32_t _random_state = 0x9e3779b9;
+    Stats _stats{};
+
+#ifndef HEADLESS
+    std::shared_ptr<Shader> _shader;
+#endif
+
+    // 0..1, xorshift
+    inline float _random() {
+        _random_state ^= _random_state << 13;
+        _random_state ^= _random_state >> 17;
+        _random_state ^= _random_state << 5;
+        return float(_random_state >> 8) * (1.0f / float(1 << 24));
+    }
+
+    // calls fn(start, end) with the physical ranges of the live particles [first, last), oldest first
+    template <class F>
+    static inline void _ranges(const _Ring& ring, const uint32_t first, const uint32_t last, F&& fn) {
+        const uint32_t capacity = ring.material.capacity;
+        const uint32_t start = (ring.tail + first) % capacity;
+        const uint32_t end = std::min(capacity, start + (last - first));
+        fn(start, end);
+        if (end - start < last - first) fn(0u, last - first - (end - start));
+    }
+
+    // new particles into [start, start + n)
+    void _emit(_Ring& ring, const ParticleBurst& burst, const uint32_t start, const uint32_t n) {
+        using v = f32x4;
+        const v one = v::splat(1.0f);
+        const v px = v::splat(burst.pos.x), py = v::splat(burst.pos.y);
+        const v ex = v::splat(burst.vel.x), ey = v::splat(burst.vel.y);
+        const v dx = v::splat(burst.dir.x), dy = v::splat(burst.dir.y);
+        const v speed = v::splat(burst.speed), fade_rate = v::splat(1.0f / ring.material.life);
+        float t[v::N], a[v::N], s[v::N];
+        for (uint32_t i = 0; i < n; i += v::N) {
+            for (int lane = 0; lane < v::N; lane++) {
+                t[lane] = _random() * burst.dt;
+                a[lane] = (_random() * 2.0f - 1.0f) * burst.spread;
+                s[lane] = 0.75f + _random() * 0.5f;
+            }
+            // dir turned by a, few terms of the series are enough for a spray
+            const v angle = v::load(a), a2 = angle * angle;
+            const v sn = angle - angle * a2 * v::splat(1.0f / 6.0f);
+            const v cs = one - a2 * v::splat(0.5f) + a2 * a2 * v::splat(1.0f / 24.0f);
+            const v k = speed * v::load(s);
+            const v vx = ex + (dx * cs - dy * sn) * k, vy = ey + (dx * sn + dy * cs) * k;
+            // born age seconds ago where the emitter was back then, and flown since
+            const v age = v::load(t);
+            const v x = px + (vx - ex) * age, y = py + (vy - ey) * age;
+            const v fade = one - age * fade_rate;
+
+            const uint32_t lanes = std::min<uint32_t>(v::N, n - i);
+            const auto put = [&](const v value, std::vector<float>& array) {
+                if (lanes == v::N) return value.store(&array[start + i]);
+                float out[v::N];
+                value.store(out);
+                std::memcpy(&array[start + i], out, sizeof(float) * lanes);
+            };
+            put(x, ring.x);
+            put(y, ring.y);
+            put(vx, ring.vx);
+            put(vy, ring.vy);
+            put(fade, ring.fade);
+        }
+    }
+
+    // [start, end) one dt further
+    static void _integrate(_Ring& ring, const uint32_t start, const uint32_t end, const float dt) {
+        using v = f32x4;
+        const float damp = std::exp(-ring.material.drag * dt), fade_step = dt / ring.material.life;
+        const v vdt = v::splat(dt), vdamp = v::splat(damp), vfade_step = v::splat(fade_step);
+        float *x = ring.x.data(), *y = ring.y.data(), *vx = ring.vx.data(), *vy = ring.vy.data(), *fade = ring.fade.data();
+        uint32_t i = start;
+        for (; i + v::N <= end; i += v::N) {
+            const v nvx = v::load(vx + i) * vdamp, nvy = v::load(vy + i) * vdamp;
+            nvx.store(vx + i);
+            nvy.store(vy + i);
+            (v::load(x + i) + nvx * vdt).store(x + i);
+            (v::load(y + i) + nvy * vdt).store(y + i);
+            (v::load(fade + i) - vfade_step).store(fade + i);
+        }
+        for (; i < end; i++) {
+            vx[i] *= damp;
+            vy[i] *= damp;
+            x[i] += vx[i] * dt;
+            y[i] += vy[i] * dt;
+            fade[i] -= fade_step;
+        }
+    }
+
+#ifndef HEADLESS
+    void _upload(const _Ring& ring) {
+        const size_t stream = sizeof(float) * ring.material.capacity;
+        glBindBuffer(GL_ARRAY_BUFFER, ring.VBO);
+        // orphan last frame's storage so the driver does not wait for it
+        glBufferData(GL_ARRAY_BUFFER, stream * 3, nullptr, GL_STREAM_DRAW);
+        size_t offset = 0;
+        _ranges(ring, 0, ring.count, [&](const uint32_t start, const uint32_t end) {
+            const size_t size = sizeof(float) * (end - start);
+            glBufferSubData(GL_ARRAY_BUFFER, offset, size, &ring.x[start]);
+            glBufferSubData(GL_ARRAY_BUFFER, stream + offset, size, &ring.y[start]);
+            glBufferSubData(GL_ARRAY_BUFFER, stream * 2 + offset, size, &ring.fade[start]);
+            offset += size;
+        });
+    }
+#endif
+
+public:
+    ParticleSystem(const ParticleSystem&) = delete;
+    ParticleSystem& operator=(const ParticleSystem&) = delete;
+#ifdef HEADLESS
+    ParticleSystem() = default;
+#else
+    ParticleSystem(ResourceManager& manager) : _shader(manager.get_shader(VERTEX_SHADER_PARTICLE, FRAGMENT_SHADER_PARTICLE)) {}
+    ~ParticleSystem() {
+        for (_Ring& ring : _rings) {
+            glDeleteVertexArrays(1, &ring.VAO);
+            glDeleteBuffers(1, &ring.VBO);
+        }
+    }
+#endif
+
+    // index for ParticleBurst::material, allocates the whole ring up front
+    uint8_t add_material(const Material& material) {
+        _Ring& ring = _rings.emplace_back();
+        ring.material = material;
+        for (std::vector<float>* array : {&ring.x, &ring.y, &ring.vx, &ring.vy, &ring.fade}) array->resize(material.capacity);
+#ifndef HEADLESS
+        const size_t stream = sizeof(float) * material.capacity;
+        glGenVertexArrays(1, &ring.VAO);
+        glGenBuffers(1, &ring.VBO);
+        glBindVertexArray(ring.VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, ring.VBO);
+        glBufferData(GL_ARRAY_BUFFER, stream * 3, nullptr, GL_STREAM_DRAW);
+        for (uint attrib = 0; attrib < 3; attrib++) {
+            glEnableVertexAttribArray(attrib);
+            glVertexAttribPointer(attrib, 1, GL_FLOAT, GL_FALSE, sizeof(float), reinterpret_cast<void*>(stream * attrib));
+        }
+        glBindVertexArray(0);
+#endif
+        return _rings.size() - 1;
+    }
+
+    void emit(const ParticleBurst& burst) {
+        if (burst.material >= _rings.size()) {
+            LEVERY(1.0, LWARN, "no particle material {}", burst.material);
+            return;
+        }
+        _Ring& ring = _rings[burst.material];
+        const uint32_t capacity = ring.material.capacity;
+        const uint32_t count = std::min<uint32_t>(burst.count, capacity);
+        if (count == 0) return;
+        // full, the oldest die early
+        if (ring.count + count > capacity) {
+            const uint32_t dropped = ring.count + count - capacity;
+            ring.tail = (ring.tail + dropped) % capacity;
+            ring.count -= dropped;
+        }
+        const uint32_t head = (ring.tail + ring.count) % capacity;
+        const uint32_t first = std::min(count, capacity - head);
+        _emit(ring, burst, head, first);
+        if (first < count) _emit(ring, burst, 0, count - first);
+        ring.count += count;
+    }
+
+    // scheduler: splits large rings over its workers, the caller does not need to be one of them
+    void update(const float dt, TaskScheduler* scheduler = nullptr) {
+        PROFILE_ZONE("ParticleSystem::update");
+        _stats.live = 0;
+        // particles per job
+        constexpr uint32_t CHUNK = 16384;
+        for (_Ring& ring : _rings) {
+            if (ring.count == 0) continue;
+            const int chunks = (ring.count + CHUNK - 1) / CHUNK;
+            const auto integrate = [&](const int start, const int end) {
+                const uint32_t first = uint32_t(start) * CHUNK, last = std::min(ring.count, uint32_t(end) * CHUNK);
+                _ranges(ring, first, last, [&](const uint32_t a, const uint32_t b) { _integrate(ring, a, b, dt); });
+            };
+            // with a single worker this thread would run every job itself
+            if (scheduler && scheduler->workers_count() > 1 && chunks > 1)
+                scheduler->parallel_for(chunks, 1, [&](int start, int end, uint32_t) { integrate(start, end); });
+            else
+                integrate(0, chunks);
+
+            // the oldest are at the tail
+            while (ring.count && ring.fade[ring.tail] <= 0.0f) {
+                ring.tail = (ring.tail + 1) % ring.material.capacity;
+                ring.count--;
+            }
+            _stats.live += ring.count;
+        }
+    }
+
+#ifndef HEADLESS
+    // additive, meant to go under the sprites
+    void draw(const glm::mat4x4& VP) {
+        PROFILE_ZONE("ParticleSystem::draw");
+        _stats.draw_calls = 0;
+        int viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        // pixels per physics unit
+        const float scale = VP[0][0] * viewport[2] / 2.0f;
+        glEnable(GL_PROGRAM_POINT_SIZE);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+        _shader->use();
+        _shader->set_mat4(Uniform::VP, VP);
+        for (const _Ring& ring : _rings) {
+            if (ring.count == 0) continue;
+            _upload(ring);
+            _shader->set_vec2(Uniform::SIZE, ring.material.size * scale);
+            _shader->set_vec4(Uniform::TINT, ring.material.color);
+            glBindVertexArray(ring.VAO);
+            glDrawArrays(GL_POINTS, 0, ring.count);
+            _stats.draw_calls++;
+        }
+        glBindVertexArray(0);
+        glBlendFunc(GL_ONE, GL_ZERO);
+    }
+#endif
+
+    inline const Stats& stats() const { return _stats; }
+};
@@ -0,0 +1,136 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Owns objects of one type in fixed-size chunks of slots. Objects never move while alive, so pointers to them
+// (Box2D user data, FarSimulation) stay valid, and freed slots are reused before the pool grows.
+// Once enough slots exist (see reserve()), spawn() and despawn() do not allocate.
+// A Handle remembers the generation of its slot, handles of despawned objects are stale and get() returns nullptr
+template <class T, size_t CHUNK = 256>
+class Pool {
+public:
+    struct Handle {
+        uint32_t index = 0;
+        // slots start at generation 0 and are never alive in it, so a default Handle is always stale
+        uint32_t generation = 0;
+        inline bool operator==(const Handle& other) const { return index == other.index && generation == other.generation; }
+        inline bool operator!=(const Handle& other) const { return !(*this == other); }
+    };
+
+private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+    struct Slot {
+        alignas(T) unsigned char storage[sizeof(T)];
+        uint32_t generation = 0;
+        // free list link while dead
+        uint32_t next_free = NONE;
+        bool alive = false;
+        inline T* get() { return std::launder(reinterpret_cast<T*>(storage)); }
+        inline const T* get() const { return std::launder(reinterpret_cast<const T*>(storage)); }
+    };
+    struct Chunk {
+        Slot slots[CHUNK];
+    };
+    std::vector<std::unique_ptr<Chunk>> _chunks{};
+    // last despawned slot
+    uint32_t _free = NONE;
+    // slots past this were never used
+    uint32_t _end = 0;
+    size_t _size = 0;
+
+    inline Slot& _slot(const uint32_t index) { return _chunks[index / CHUNK]->slots[index % CHUNK]; }
+    inline const Slot& _slot(const uint32_t index) const { return _chunks[index / CHUNK]->slots[index % CHUNK]; }
+
+    // walks alive slots in index order
+    template <class P, class V>
+    class _Iterator {
+        P* _pool;
+        uint32_t _index;
+        inline void _skip() {
+            while (_index < _pool->_end && !_pool->_slot(_index).alive) _index++;
+        }
+
+    public:
+        _Iterator(P* pool, const uint32_t index) : _pool(pool), _index(index) { _skip(); }
+        inline V& operator*() const { return *_pool->_slot(_index).get(); }
+        inline V* operator->() const { return _pool->_slot(_index).get(); }
+        inline _Iterator& operator++() {
+            _index++;
+            _skip();
+            return *this;
+        }
+        inline bool operator!=(const _Iterator& other) const { return _index != other._index; }
+        inline Handle handle() const { return {_index, _pool->_slot(_index).generation}; }
+    };
+
+public:
+    using iterator = _Iterator<Pool, T>;
+    using const_iterator = _Iterator<const Pool, const T>;
+
+    Pool() = default;
+    Pool(const Pool&) = delete;
+    Pool& operator=(const Pool&) = delete;
+    ~Pool() { clear(); }
+
+    // makes room for `capacity` objects alive at once
+    void reserve(const size_t capacity) {
+        while (_chunks.size() * CHUNK < capacity) _chunks.push_back(std::make_unique<Chunk>());
+    }
+
+    template <class... Args>
+    Handle spawn(Args&&... args) {
+        uint32_t index;
+        if (_free != NONE) {
+            index = _free;
+            _free = _slot(index).next_free;
+        } else {
+            if (_end == _chunks.size() * CHUNK) _chunks.push_back(std::make_unique<Chunk>());
+            index = _end++;
+        }
+        Slot& slot = _slot(index);
+        new (slot.storage) T(std::forward<Args>(args)...);
+        if (++slot.generation == 0) slot.generation = 1;
+        slot.alive = true;
+        _size++;
+        return {index, slot.generation};
+    }
+    // false if the handle is stale
+    bool despawn(const Handle handle) {
+        T* object = get(handle);
+        if (!object) return false;
+        object->~T();
+        Slot& slot = _slot(handle.index);
+        slot.alive = false;
+        slot.next_free = _free;
+        _free = handle.index;
+        _size--;
+        return true;
+    }
+    void clear() {
+        for (uint32_t i = 0; i < _end; i++) {
+            Slot& slot = _slot(i);
+            if (slot.alive) despawn({i, slot.generation});
+        }
+    }
+
+    // nullptr if the handle is stale
+    inline T* get(const Handle handle) {
+        if (handle.index >= _end) return nullptr;
+        Slot& slot = _slot(handle.index);
+        return slot.alive && slot.generation == handle.generation ? slot.get() : nullptr;
+    }
+    inline const T* get(const Handle handle) const { return const_cast<Pool*>(this)->get(handle); }
+
+    inline iterator begin() { return {this, 0}; }
+    inline iterator end() { return {this, _end}; }
+    inline const_iterator begin() const { return {this, 0}; }
+    inline const_iterator end() const { return {this, _end}; }
+
+    inline size_t size() const { return _size; }
+    inline bool empty() const { return _size == 0; }
+    inline size_t capacity() const { return _chunks.size() * CHUNK; }
+};
@@ -0,0 +1,177 @@
+#pragma once
+// Scoped-zone profiler with Chrome/Perfetto trace export (chrome://tracing, ui.perfetto.dev).
+// Enabled by the PROFILER define (cmake -DTURNED_PROFILER=ON), otherwise every macro below expands to nothing.
+//  PROFILE_ZONE("name")      CPU time of the enclosing scope
+//  PROFILE_GPU_ZONE("name")  GPU time of the GL commands issued in the enclosing scope (render thread, not nested)
+//  PROFILE_GPU_COLLECT()     once per frame, reads back finished GPU queries
+//  PROFILE_DUMP()            writes the recorded events to PROFILER_TRACE_PATH
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+constexpr static const char* PROFILER_TRACE_PATH = "turned_trace.json";
+
+#ifdef PROFILER
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+#ifndef HEADLESS
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#endif
+
+#include "log.cpp"
+
+class Profiler {
+public:
+    struct Event {
+        const char* name;
+        uint64_t start_ns;
+        uint64_t end_ns;
+    };
+    // per thread, oldest events are overwritten
+    constexpr static size_t RING_SIZE = 1 << 16;
+    struct Ring {
+        uint32_t tid;
+        const char* name;
+        // written only by the owning thread
+        std::atomic<uint64_t> head{0};
+        Event events[RING_SIZE];
+    };
+
+private:
+    std::mutex _mutex{};
+    std::vector<std::unique_ptr<Ring>> _rings{};
+
+    Ring* _register(const char* name) {
+        std::lock_guard lock(_mutex);
+        _rings.push_back(std::make_unique<Ring>());
+        _rings.back()->tid = _rings.size();
+        _rings.back()->name = name;
+        return _rings.back().get();
+    }
+
+#ifndef HEADLESS
+    struct GpuQuery {
+        uint id = 0;
+        const char* name = nullptr;
+        uint64_t cpu_start_ns = 0;
+        bool pending = false;
+    };
+    // a few frames worth of zones in flight
+    constexpr static size_t GPU_QUERIES = 64;
+    GpuQuery _gpu_queries[GPU_QUERIES]{};
+    size_t _gpu_next = 0;
+    GpuQuery* _gpu_open = nullptr;
+    Ring* _gpu_ring = nullptr;
+#endif
+
+public:
+    static Profiler& get() {
+        static Profiler profiler{};
+        return profiler;
+    }
+    static inline uint64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    inline void record(const char* name, const uint64_t start_ns, const uint64_t end_ns) {
+        thread_local Ring* ring = _register("cpu");
+        _push(*ring, name, start_ns, end_ns);
+    }
+    static inline void _push(Ring& ring, const char* name, const uint64_t start_ns, const uint64_t end_ns) {
+        const uint64_t head = ring.head.load(std::memory_order_relaxed);
+        ring.events[head % RING_SIZE] = {name, start_ns, end_ns};
+        ring.head.store(head + 1, std::memory_order_release);
+    }
+
+#ifndef HEADLESS
+    // GL_TIME_ELAPSED queries. The result is placed on its own track at the CPU time the zone was issued
+    void gpu_begin(const char* name) {
+        GpuQuery& query = _gpu_queries[_gpu_next];
+        // slot still in flight, GPU is too far behind: drop the zone
+        if (query.pending || _gpu_open) return;
+        if (!query.id) glGenQueries(1, &query.id);
+        _gpu_next = (_gpu_next + 1) % GPU_QUERIES;
+        query.name = name;
+        query.cpu_start_ns = now_ns();
+        glBeginQuery(GL_TIME_ELAPSED, query.id);
+        _gpu_open = &query;
+    }
+    void gpu_end() {
+        if (!_gpu_open) return;
+        glEndQuery(GL_TIME_ELAPSED);
+        _gpu_open->pending = true;
+        _gpu_open = nullptr;
+    }
+    void gpu_collect() {
+        if (!_gpu_ring) _gpu_ring = _register("gpu");
+        for (GpuQuery& query : _gpu_queries) {
+            if (!query.pending) continue;
+            int available = 0;
+            glGetQueryObjectiv(query.id, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) continue;
+            GLuint64 elapsed_ns = 0;
+            glGetQueryObjectui64v(query.id, GL_QUERY_RESULT, &elapsed_ns);
+            _push(*_gpu_ring, query.name, query.cpu_start_ns, query.cpu_start_ns + elapsed_ns);
+            query.pending = false;
+        }
+    }
+#endif
+
+    // Chrome trace event format, complete ("X") events in microseconds
+    bool dump(const char* path) {
+        std::FILE* file = std::fopen(path, "w");
+        if (!file) {
+            LERR("failed to open {} for the trace", path);
+            return false;
+        }
+        std::lock_guard lock(_mutex);
+        size_t count = 0;
+        std::fputs("{\"traceEvents\":[\n", file);
+        for (const std::unique_ptr<Ring>& ring : _rings) {
+            std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s %u\"}}", count ? ",\n" : "", ring->tid,
+                         ring->name, ring->tid);
+            count++;
+            const uint64_t head = ring->head.load(std::memory_order_acquire);
+            for (uint64_t i = head > RING_SIZE ? head - RING_SIZE : 0; i < head; i++) {
+                const Event& event = ring->events[i % RING_SIZE];
+                std::fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", event.name, ring->tid,
+                             event.start_ns / 1000.0, (event.end_ns - event.start_ns) / 1000.0);
+                count++;
+            }
+        }
+        std::fputs("\n]}\n", file);
+        std::fclose(file);
+        LINFO("trace with {} events written to {}", count, path);
+        return true;
+    }
+};
+
+struct ProfileZone {
+    const char* name;
+    const uint64_t start_ns;
+    ProfileZone(const char* name) : name(name), start_ns(Profiler::now_ns()) {}
+    ~ProfileZone() { Profiler::get().record(name, start_ns, Profiler::now_ns()); }
+};
+#ifndef HEADLESS
+struct GpuProfileZone {
+    GpuProfileZone(const char* name) { Profiler::get().gpu_begin(name); }
+    ~GpuProfileZone() { Profiler::get().gpu_end(); }
+};
+#endif
+
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(_profile_zone_, __LINE__)(name)
+#define PROFILE_GPU_ZONE(name) GpuProfileZone PROFILE_CONCAT(_profile_gpu_zone_, __LINE__)(name)
+#define PROFILE_GPU_COLLECT() Profiler::get().gpu_collect()
+#define PROFILE_DUMP() Profiler::get().dump(PROFILER_TRACE_PATH)
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_GPU_ZONE(name)
+#define PROFILE_GPU_COLLECT()
+#define PROFILE_DUMP()
+#endif
@@ -0,0 +1,286 @@
+#pragma once
+#include <box2d/math_functions.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "globals.hpp"
+#include "hash.hpp"
+#include "log.cpp"
+#include "ship.cpp"
+#include "world.cpp"
+
+// Input of a session, tick by tick, so a headless run (turned_sim --replay) can repeat it as fast as it steps.
+// Recorded at the Ship::IController boundary: whatever get() returned is what the ship flew with.
+// Layout, native endianness:
+//   Header
+//   varint ticks in which no frame changed
+//   per tick with a change: a mask byte per channel, the changed fields raw (throttle, slide, lookat.x, lookat.y),
+//     then the varint of unchanged ticks after it
+//   END mask, uint64 state_hash() after the last tick
+// Values are stored exactly, so the replay is bit identical as long as it builds the same setup
+struct ReplaySetup {
+    // Sectors seed
+    uint32_t seed = 1;
+    // World::far_radius
+    float far_radius = FAR_SIMULATION_RADIUS;
+    double dt = PHYSICS_DT;
+    // of the player ship, as given to World::spawn_ship(), pixels
+    b2Transform player{{0.0f, 0.0f}, {1.0f, 0.0f}};
+};
+
+// transforms of every ship in pool order, to tell whether a replay diverged
+inline uint64_t state_hash(World& world) {
+    uint64_t out = FNV1A_SEED;
+    for (const Ship& ship : world.ships) {
+        const Transform transform = ship.get_transform();
+        out = fnv1a(std::string_view(reinterpret_cast<const char*>(&transform), sizeof(transform)), out);
+    }
+    return out;
+}
+
+struct ReplayFormat {
+    constexpr static char MAGIC[8] = {'T', 'U', 'R', 'N', 'R', 'E', 'P', 'L'};
+    constexpr static uint32_t VERSION = 3;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        // recorded controllers
+        uint32_t channels;
+        ReplaySetup setup;
+    };
+    enum Mask : uint8_t {
+        THROTTLE = 1 << 0,
+        SLIDE = 1 << 1,
+        LOOKAT_X = 1 << 2,
+        LOOKAT_Y = 1 << 3,
+        // in place of the first channel's mask
+        END = 1 << 7,
+    };
+
+    // bitwise, so -0.0 and NaN payloads survive
+    template <class T>
+    static inline bool same(const T& a, const T& b) {
+        return !std::memcmp(&a, &b, sizeof(T));
+    }
+    static inline uint8_t diff(const Ship::InputFrame& a, const Ship::InputFrame& b) {
+        return (same(a.throttle, b.throttle) ? 0 : THROTTLE) | (same(a.slide, b.slide) ? 0 : SLIDE) | (same(a.lookat.x, b.lookat.x) ? 0 : LOOKAT_X) |
+               (same(a.lookat.y, b.lookat.y) ? 0 : LOOKAT_Y);
+    }
+};
+
+// wraps the controllers of a session and appends their frames to a file. Simulation thread only
+class InputRecorder {
+    class _Channel final : public Ship::IController {
+    public:
+        const std::shared_ptr<Ship::IController> inner;
+        // returned during this tick
+        Ship::InputFrame frame{};
+
+        _Channel(const std::shared_ptr<Ship::IController>& inner) : inner(inner) { batched = inner->batched; }
+        void update(const Input& input) override { inner->update(input); }
+        Ship::InputFrame get(const Ship& ship) override { return frame = inner->get(ship); }
+        bool save_state(u_char* out) const override { return inner->save_state(out); }
+        void load_state(const u_char* in) override { inner->load_state(in); }
+    };
+
+    FILE* _file = nullptr;
+    std::vector<std::shared_ptr<_Channel>> _channels{};
+    // as last written
+    std::vector<Ship::InputFrame> _written{};
+    std::vector<u_char> _buffer{};
+    uint64_t _idle = 0;
+    uint64_t _ticks = 0;
+    size_t _bytes = 0;
+
+    template <class T>
+    inline void _put(const T& value) {
+        const u_char* bytes = reinterpret_cast<const u_char*>(&value);
+        _buffer.insert(_buffer.end(), bytes, bytes + sizeof(T));
+    }
+    inline void _put_varint(uint64_t value) {
+        for (; value >= 0x80; value >>= 7) { _buffer.push_back(u_char(value) | 0x80); }
+        _buffer.push_back(u_char(value));
+    }
+    void _flush() {
+        if (_buffer.empty()) return;
+        if (std::fwrite(_buffer.data(), 1, _buffer.size(), _file) != _buffer.size()) LEVERY(1.0, LERR, "failed to write the recording");
+        _bytes += _buffer.size();
+        _buffer.clear();
+    }
+
+public:
+    InputRecorder() = default;
+    InputRecorder(const InputRecorder&) = delete;
+    InputRecorder& operator=(const InputRecorder&) = delete;
+    ~InputRecorder() {
+        if (_file) std::fclose(_file);
+    }
+
+    // before open(), the returned controller replaces inner on its ship
+    std::shared_ptr<Ship::IController> add(const std::shared_ptr<Ship::IController>& inner) {
+        _channels.push_back(std::make_shared<_Channel>(inner));
+        return _channels.back();
+    }
+    bool open(const char* path, const ReplaySetup& setup) {
+        _file = std::fopen(path, "wb");
+        if (!_file) LERRRET(false, "failed to open {}: {}", path, std::strerror(errno));
+        ReplayFormat::Header header{};
+        std::memcpy(header.magic, ReplayFormat::MAGIC, sizeof(header.magic));
+        header.version = ReplayFormat::VERSION;
+        header.channels = _channels.size();
+        header.setup = setup;
+        _put(header);
+        // the first frame is diffed against a cleared one, like the replay starts from
+        _written.assign(_channels.size(), {});
+        LINFO("recording {} controllers to {}", _channels.size(), path);
+        return true;
+    }
+    inline bool is_open() const { return _file; }
+
+    // after the world step
+    void end_tick() {
+        if (!_file) return;
+        _ticks++;
+        bool changed = false;
+        for (size_t i = 0; i < _channels.size() && !changed; i++) { changed = ReplayFormat::diff(_written[i], _channels[i]->frame); }
+        if (!changed) {
+            _idle++;
+            return;
+        }
+        _put_varint(_idle);
+        _idle = 0;
+        for (size_t i = 0; i < _channels.size(); i++) {
+            const Ship::InputFrame& frame = _channels[i]->frame;
+            const uint8_t mask = ReplayFormat::diff(_written[i], frame);
+            _put(mask);
+            if (mask & ReplayFormat::THROTTLE) _put(frame.throttle);
+            if (mask & ReplayFormat::SLIDE) _put(frame.slide);
+            if (mask & ReplayFormat::LOOKAT_X) _put(frame.lookat.x);
+            if (mask & ReplayFormat::LOOKAT_Y) _put(frame.lookat.y);
+            _written[i] = frame;
+        }
+        if (_buffer.size() >= 64 * 1024) _flush();
+    }
+    // world: as it is after the last end_tick()
+    void close(World& world) {
+        if (!_file) return;
+        const uint64_t hash = state_hash(world);
+        _put_varint(_idle);
+        _put(uint8_t(ReplayFormat::END));
+        _put(hash);
+        _flush();
+        if (std::fclose(_file)) LERR("failed to write the recording");
+        _file = nullptr;
+        LINFO("recorded {} ticks in {} bytes, state {:016x}", _ticks, _bytes, hash);
+    }
+};
+
+// feeds a recording back through Ship::IController, one next_tick() per world step
+class InputReplay {
+    class _Channel final : public Ship::IController {
+    public:
+        Ship::InputFrame frame{};
+
+        void update(const Input& input) override {}
+        Ship::InputFrame get(const Ship& ship) override { return frame; }
+    };
+
+    std::vector<u_char> _data{};
+    size_t _at = 0;
+    std::vector<std::shared_ptr<_Channel>> _channels{};
+    // unchanged ticks before the next change
+    uint64_t _idle = 0;
+    bool _ended = false;
+    bool _complete = false;
+    uint64_t _hash = 0;
+
+    template <class T>
+    inline bool _get(T& out) {
+        if (_data.size() - _at < sizeof(T)) return false;
+        std::memcpy(&out, _data.data() + _at, sizeof(T));
+        _at += sizeof(T);
+        return true;
+    }
+    inline bool _get_varint(uint64_t& out) {
+        out = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t byte;
+            if (!_get(byte)) return false;
+            out |= uint64_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+
+public:
+    ReplaySetup setup{};
+
+    bool open(const char* path) {
+        FILE* file = std::fopen(path, "rb");
+        if (!file) LERRRET(false, "failed to open {}: {}", path, std::strerror(errno));
+        std::fseek(file, 0, SEEK_END);
+        _data.resize(std::ftell(file));
+        std::fseek(file, 0, SEEK_SET);
+        const bool read = std::fread(_data.data(), 1, _data.size(), file) == _data.size();
+        std::fclose(file);
+        if (!read) LERRRET(false, "failed to read {}", path);
+
+        ReplayFormat::Header header;
+        _at = 0;
+        if (!_get(header) || std::memcmp(header.magic, ReplayFormat::MAGIC, sizeof(header.magic))) LERRRET(false, "{} is not a recording", path);
+        if (header.version != ReplayFormat::VERSION) LERRRET(false, "recording {} is version {}, expected {}", path, header.version, ReplayFormat::VERSION);
+        setup = header.setup;
+        _channels.clear();
+        for (uint32_t i = 0; i < header.channels; i++) { _channels.push_back(std::make_shared<_Channel>()); }
+        _ended = _complete = false;
+        if (!_get_varint(_idle)) LERRRET(false, "recording {} is truncated", path);
+        return true;
+    }
+
+    inline size_t channels() const { return _channels.size(); }
+    inline std::shared_ptr<Ship::IController> controller(const size_t channel) const { return _channels[channel]; }
+
+    // frames of the next tick into the controllers, false after the last one
+    bool next_tick() {
+        if (_ended) return false;
+        if (_idle > 0) {
+            _idle--;
+            return true;
+        }
+        if (_at < _data.size() && _data[_at] & ReplayFormat::END) {
+            _at++;
+            _ended = true;
+            if (!_get(_hash)) LERRRET(false, "recording is truncated");
+            _complete = true;
+            return false;
+        }
+        for (const std::shared_ptr<_Channel>& channel : _channels) {
+            uint8_t mask;
+            bool ok = _get(mask);
+            if (ok && mask & ReplayFormat::THROTTLE) ok = _get(channel->frame.throttle);
+            if (ok && mask & ReplayFormat::SLIDE) ok = _get(channel->frame.slide);
+            if (ok && mask & ReplayFormat::LOOKAT_X) ok = _get(channel->frame.lookat.x);
+            if (ok && mask & ReplayFormat::LOOKAT_Y) ok = _get(channel->frame.lookat.y);
+            if (!ok) {
+                _ended = true;
+                LERRRET(false, "recording is truncated");
+            }
+        }
+        if (!_get_varint(_idle)) {
+            _ended = true;
+            LERRRET(false, "recording is truncated");
+        }
+        return true;
+    }
+    // true once every tick was replayed and the recording was complete
+    inline bool complete() const { return _complete; }
+    // state_hash() of the recorded session, see complete()
+    inline uint64_t expected_hash() const { return _hash; }
+};
@@ -1,57 +1,331 @@
 #pragma once
-#include <map>
+#include <cstdint>
+#include <filesystem>
 #include <memory>
+#include <mutex>
+#include <stb_image.h>
+#include <string>
 #include <tuple>
+#include <vector>
 
+#include "asset_pack.cpp"
+#include "flat_map.cpp"
+#include "hash.hpp"
+#include "log.cpp"
 #include "mesh.cpp"
-#include "shader.cpp"
 #include "texture.cpp"
+#ifndef HEADLESS
+#include "atlas.cpp"
+#include "shader.cpp"
+#include "task_scheduler.cpp"
+#endif
 
 inline constexpr decltype(std::ignore) preload{};
 
+// a resource path interned into its FNV-1a hash, equal strings from any call site get equal ids.
+// Hashed at compile time for literals (constexpr ResourceId SHIP = "assets/ship01.png"), at runtime otherwise
+struct ResourceId {
+    uint64_t hash = 0;
+    // what was hashed, only read when the resource is loaded
+    const char* path = nullptr;
+
+    constexpr ResourceId() = default;
+    constexpr ResourceId(const char* path) : hash(fnv1a(path)), path(path) {}
+    // path must outlive the id
+    ResourceId(const std::string& path) : ResourceId(path.c_str()) {}
+    // hashes only, ResourceManager compares the paths of a hit so a collision never hands out another resource
+    inline bool operator==(const ResourceId& other) const { return hash == other.hash; }
+    struct Hash {
+        inline uint64_t operator()(const ResourceId& id) const { return id.hash; }
+    };
+};
+
 class ResourceManager {
 public:
-    // File path
-    using TextureKey = const char*;
     // Pointers to shader sources
     // NOT ACTUAL SOURCE DATA, ONLY CONSTANT C-STRINGS
     // TODO: use enums instead of maps for shaders
     struct ShaderKey {
-        const char* vertex_src;
-        const char* fragment_src;
-        const bool operator<(const ShaderKey& other) const { return vertex_src < other.vertex_src || fragment_src < other.fragment_src; }
+        const char* vertex_src = nullptr;
+        const char* fragment_src = nullptr;
+        inline bool operator==(const ShaderKey& other) const { return vertex_src == other.vertex_src && fragment_src == other.fragment_src; }
+        struct Hash {
+            inline uint64_t operator()(const ShaderKey& key) const { return fnv1a({reinterpret_cast<const char*>(&key), sizeof(key)}); }
+        };
     };
     // Rectangle dimensions
     // TODO: use shader uniforms for dimensions instead of different meshes
     //  / actually done by scaling Model matrix (see Sprite::_get_model())
     struct MeshRectKey {
-        const float xpivot;
-        const float ypivot;
-        const float w;
-        const float h;
+        float xpivot = 0.0f;
+        float ypivot = 0.0f;
+        float w = 0.0f;
+        float h = 0.0f;
 
-        const bool operator<(const MeshRectKey& other) const { return xpivot < other.xpivot || ypivot < other.ypivot || w < other.w || h < other.h; }
+        inline bool operator==(const MeshRectKey& other) const {
+            return xpivot == other.xpivot && ypivot == other.ypivot && w == other.w && h == other.h;
+        }
+        struct Hash {
+            inline uint64_t operator()(const MeshRectKey& key) const {
+                // + 0.0f turns -0.0f into 0.0f, they compare equal so they must hash equal
+                const float bits[] = {key.xpivot + 0.0f, key.ypivot + 0.0f, key.w + 0.0f, key.h + 0.0f};
+                return fnv1a({reinterpret_cast<const char*>(bits), sizeof(bits)});
+            }
+        };
+    };
+    struct Stats {
+        size_t lookups = 0;
+        // resources created
+        size_t loads = 0;
+        // textures asked for by another spelling of a path loaded before (ex. "./assets/a.png"), served by the first load
+        size_t duplicate_loads = 0;
     };
 
+    // next to the executable, built by the assets_pack target. Textures missing from it are loaded from their files
+    constexpr static const char* ASSET_PACK = "assets.pack";
+#ifndef HEADLESS
+    // bytes of decoded pixels sent to the GPU per pump_uploads() call
+    constexpr static size_t UPLOAD_BUDGET = 4 << 20;
+#endif
+
 private:
-    std::map<TextureKey, std::shared_ptr<Texture> > textures;
-    std::map<MeshRectKey, std::shared_ptr<Mesh> > meshes_rect;
-    std::map<ShaderKey, std::shared_ptr<Shader> > shaders;
+#ifndef HEADLESS
+    TextureAtlas atlas{};
+    FlatMap<ShaderKey, std::shared_ptr<Shader>, ShaderKey::Hash> shaders;
+#endif
+    struct TextureEntry {
+        std::shared_ptr<Texture> texture{};
+        // as first asked for, tells hash collisions apart
+        std::string path{};
+    };
+    FlatMap<ResourceId, TextureEntry, ResourceId::Hash> textures;
+    // by lexically normal path
+    FlatMap<ResourceId, TextureEntry, ResourceId::Hash> _files;
+    FlatMap<MeshRectKey, std::shared_ptr<Mesh>, MeshRectKey::Hash> meshes_rect;
+    Stats _stats{};
+    AssetPack _pack{};
+
+#ifdef HEADLESS
+    // reads only the image header, nothing is decoded
+    std::shared_ptr<Texture> _load_texture(const char* path) {
+        if (const AssetPack::Entry* entry = _pack.find(fnv1a(path)))
+            return std::make_shared<Texture>(nullptr, glm::vec4(0.0f, 0.0f, 1.0f, 1.0f), entry->w, entry->h);
+        int w, h, nchannels;
+        if (!stbi_info(path, &w, &h, &nchannels)) {
+            LERR("failed to read texture {}: {}", path, stbi_failure_reason());
+            w = h = 0;
+        }
+        return std::make_shared<Texture>(nullptr, glm::vec4(0.0f, 0.0f, 1.0f, 1.0f), w, h);
+    }
+#else
+    // nullptr decodes synchronously
+    TaskScheduler* _scheduler;
+    struct DecodeJob {
+        ResourceManager* self;
+        std::string path;
+        std::shared_ptr<Texture> texture;
+        TextureAtlas::Region region;
+        // nullptr if decoding failed
+        u_char* pixels = nullptr;
+    };
+    TaskScheduler::TaskGroup _decoding{};
+    std::mutex _decoded_mutex{};
+    // decoded on the scheduler, waiting for pump_uploads()
+    std::vector<std::unique_ptr<DecodeJob> > _decoded{};
+    uint _pbo = 0;
+    // client memory fallback of _upload()
+    std::vector<u_char> _padded{};
+    std::shared_ptr<Texture> _placeholder{};
+    std::shared_ptr<Texture> _missing{};
+
+    // runs on a scheduler worker
+    static void _decode(int, int, uint32_t, void* context) {
+        DecodeJob* job = static_cast<DecodeJob*>(context);
+        int w, h, nchannels;
+        stbi_set_flip_vertically_on_load_thread(true);
+        job->pixels = stbi_load(job->path.c_str(), &w, &h, &nchannels, 4);
+        if (!job->pixels)
+            LERR("failed to load texture {}: {}", job->path, stbi_failure_reason());
+        else if (uint(w) != job->texture->w() || uint(h) != job->texture->h()) {
+            LERR("texture {} changed size while loading", job->path);
+            stbi_image_free(job->pixels);
+            job->pixels = nullptr;
+        }
+        std::lock_guard lock(job->self->_decoded_mutex);
+        job->self->_decoded.emplace_back(job);
+    }
+    // streams the image through a pixel buffer object, so glTexSubImage2D does not block on client memory
+    void _upload(const TextureAtlas::Region& region, const u_char* pixels, const uint w, const uint h) {
+        if (!_pbo) glGenBuffers(1, &_pbo);
+        const size_t size = TextureAtlas::padded_size(w, h);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _pbo);
+        // orphaned every time, the driver hands out fresh storage while older uploads are in flight
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        u_char* dst = static_cast<u_char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+        if (dst) {
+            TextureAtlas::extrude(pixels, w, h, dst);
+            // GL_FALSE if the storage got corrupted while mapped (mode switch and the like)
+            if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) {
+                // with an unpack buffer bound the data pointer is an offset into it
+                region.page->upload(region.x, region.y, region.w, region.h, nullptr);
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                return;
+            }
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        LEVERY(1.0, LWARN, "failed to map the pixel buffer (GL error {:#x}), uploading from client memory", glGetError());
+        _padded.resize(size);
+        TextureAtlas::extrude(pixels, w, h, _padded.data());
+        region.page->upload(region.x, region.y, region.w, region.h, _padded.data());
+    }
+
+    std::shared_ptr<Texture> _load_texture(const char* path) {
+        // decoded offline, uploaded straight from the mapping
+        if (const AssetPack::Entry* entry = _pack.find(fnv1a(path))) {
+            const TextureAtlas::Region region = atlas.reserve(entry->w, entry->h);
+            region.page->upload(region.x, region.y, region.w, region.h, _pack.pixels(*entry));
+            LTRACE("{}: w{} h{}, from {}", path, entry->w, entry->h, ASSET_PACK);
+            return std::make_shared<Texture>(region.page, region.uv, entry->w, entry->h);
+        }
+        int w, h, nchannels;
+        if (!_scheduler || _scheduler->workers_count() == 1) {
+            stbi_set_flip_vertically_on_load(true);
+            // always RGBA so every image fits any atlas page
+            u_char* data = stbi_load(path, &w, &h, &nchannels, 4);
+            if (!data) {
+                LERR("failed to load texture {}: {}", path, stbi_failure_reason());
+                return _missing_texture();
+            }
+            LTRACE("{}: w{} h{} channels{}", path, w, h, nchannels);
+            std::shared_ptr<Texture> out = atlas.add(data, w, h);
+            stbi_image_free(data);
+            return out;
+        }
+        // only the header now, so sprites and bodies get their size right away
+        if (!stbi_info(path, &w, &h, &nchannels)) {
+            LERR("failed to read texture {}: {}", path, stbi_failure_reason());
+            return _missing_texture();
+        }
+        LTRACE("{}: w{} h{} channels{}, decoding in background", path, w, h, nchannels);
+        const std::shared_ptr<Texture> placeholder = _placeholder_texture();
+        DecodeJob* job = new DecodeJob{this, path, std::make_shared<Texture>(placeholder->page(), placeholder->uv(), w, h), atlas.reserve(w, h)};
+        _scheduler->enqueue(_decoding, &_decode, job, 1);
+        return job->texture;
+    }
+    static std::vector<u_char> _pattern(const uint w, const uint h, u_char (*color)(uint x, uint y, uint channel)) {
+        std::vector<u_char> data(size_t(w) * h * 4);
+        for (size_t i = 0; i < data.size(); i++) { data[i] = color(i / 4 % w, i / 4 / w, i % 4); }
+        return data;
+    }
+    static std::shared_ptr<Texture> _solid_texture(TextureAtlas& atlas, const uint size, u_char (*color)(uint x, uint y, uint channel)) {
+        return atlas.add(_pattern(size, size, color).data(), size, size);
+    }
+    // magenta/black checkerboard
+    static u_char _missing_color(const uint x, const uint y, const uint channel) {
+        const bool odd = (x / 4 + y / 4) % 2;
+        return channel == 3 || (odd && channel != 1) ? 0xff : 0x00;
+    }
+    std::shared_ptr<Texture> _missing_texture() {
+        if (!_missing) _missing = _solid_texture(atlas, 8, &_missing_color);
+        return _missing;
+    }
+    // flat grey, shown until the real image is uploaded
+    std::shared_ptr<Texture> _placeholder_texture() {
+        if (!_placeholder) _placeholder = _solid_texture(atlas, 4, [](uint, uint, uint channel) -> u_char { return channel == 3 ? 0xff : 0x40; });
+        return _placeholder;
+    }
+#endif
+
+public:
+    ResourceManager(const ResourceManager&) = delete;
+    ResourceManager& operator=(const ResourceManager&) = delete;
+#ifdef HEADLESS
+    ResourceManager() { _pack.open(ASSET_PACK); }
+#else
+    ResourceManager(TaskScheduler* scheduler = nullptr) : _scheduler(scheduler) { _pack.open(ASSET_PACK); }
+    ~ResourceManager() {
+        if (_scheduler) _scheduler->wait(_decoding);
+        for (const std::unique_ptr<DecodeJob>& job : _decoded) { stbi_image_free(job->pixels); }
+        if (_pbo) glDeleteBuffers(1, &_pbo);
+    }
+
+    // uploads decoded textures, at least one and then up to budget bytes. Call once per frame
+    void pump_uploads(const size_t budget = UPLOAD_BUDGET) {
+        std::vector<std::unique_ptr<DecodeJob> > ready{};
+        {
+            std::lock_guard lock(_decoded_mutex);
+            size_t bytes = 0, n = 0;
+            for (; n < _decoded.size() && (n == 0 || bytes < budget); n++) {
+                bytes += TextureAtlas::padded_size(_decoded[n]->texture->w(), _decoded[n]->texture->h());
+            }
+            ready.insert(ready.end(), std::make_move_iterator(_decoded.begin()), std::make_move_iterator(_decoded.begin() + n));
+            _decoded.erase(_decoded.begin(), _decoded.begin() + n);
+        }
+        for (const std::unique_ptr<DecodeJob>& job : ready) {
+            if (!job->pixels) {
+                // the packer can not take the reserved region back, it shows the checkerboard instead
+                const std::vector<u_char> missing = _pattern(job->texture->w(), job->texture->h(), &_missing_color);
+                _upload(job->region, missing.data(), job->texture->w(), job->texture->h());
+                job->texture->_set_region(job->region.page, job->region.uv);
+                continue;
+            }
+            _upload(job->region, job->pixels, job->texture->w(), job->texture->h());
+            job->texture->_set_region(job->region.page, job->region.uv);
+            stbi_image_free(job->pixels);
+            LTRACE("{} uploaded", job->path);
+        }
+    }
+#endif
+
+private:
+    // one texture per lexically normal path, whatever spelling asked for it first
+    std::shared_ptr<Texture> _get_file(const std::string& path) {
+        const std::string normal = std::filesystem::path(path).lexically_normal().string();
+        TextureEntry& file = _files[ResourceId(normal)];
+        if (file.texture && file.path == normal) {
+            _stats.duplicate_loads++;
+            LWARN("texture {} is {}, loaded already", path, normal);
+            return file.texture;
+        }
+        _stats.loads++;
+        // the pack is keyed by normalized paths too, see pack_assets
+        if (file.texture) {
+            LERR("resource id collision: {} and {}", file.path, normal);
+            return _load_texture(normal.c_str());
+        }
+        file.path = normal;
+        file.texture = _load_texture(normal.c_str());
+        return file.texture;
+    }
 
 public:
     [[nodiscard("Are you preloading resources? Use preload = get_texture() then")]]
-    std::shared_ptr<Texture> get_texture(const char* path) {
-        std::shared_ptr<Texture>& ptr = textures[path];
-        if (!ptr) ptr = std::make_shared<Texture>(path);
-        return ptr;
+    std::shared_ptr<Texture> get_texture(const ResourceId id) {
+        _stats.lookups++;
+        TextureEntry& entry = textures[id];
+        if (entry.texture) {
+            if (entry.path == id.path) return entry.texture;
+            // too rare to chain, the second path is loaded past the cache
+            LERR("resource id collision: {} and {}", entry.path, id.path);
+            return _get_file(id.path);
+        }
+        entry.path = id.path;
+        entry.texture = _get_file(entry.path);
+        return entry.texture;
     }
 
+#ifndef HEADLESS
     [[nodiscard("Are you preloading resources? Use preload = get_shader() then")]]
     std::shared_ptr<Shader> get_shader(const char* vertex_src, const char* fragment_src) {
+        _stats.lookups++;
         auto& ptr = shaders[{vertex_src, fragment_src}];
-        if (!ptr) ptr = std::make_shared<Shader>(vertex_src, fragment_src);
+        if (!ptr) {
+            _stats.loads++;
+            ptr = std::make_shared<Shader>(vertex_src, fragment_src);
+        }
         return ptr;
     }
+#endif
 
     [[nodiscard("Are you preloading resources? Use preload = get_mesh_rect() then")]]
     std::shared_ptr<Mesh> get_mesh_rect(const float xpivot, const float ypivot, const float w, const float h) {
@@ -65,9 +339,17 @@ public:
             0, 1, 3,  // first triangle
             1, 2, 3   // second triangle
         };
+        _stats.lookups++;
         auto& ptr = meshes_rect[{xpivot, ypivot, w, h}];
-        if (!ptr) ptr = std::make_shared<Mesh>(vertices, sizeof(vertices) / sizeof(Vertex), indices, sizeof(indices) / sizeof(uint));
+        if (!ptr) {
+            _stats.loads++;
+            ptr = std::make_shared<Mesh>(vertices, sizeof(vertices) / sizeof(Vertex), indices, sizeof(indices) / sizeof(uint));
+        }
         return ptr;
     }
     std::shared_ptr<Mesh> get_quad_1x1() { return get_mesh_rect(0.5f, 0.5f, 1.0f, 1.0f); }
+    inline const Stats& stats() const { return _stats; }
+#ifndef HEADLESS
+    inline size_t atlas_pages_count() const { return atlas.pages_count(); }
+#endif
 };
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "log.cpp"
+#include "profiler.cpp"
+#include "world.cpp"
+
+// the WorldState after each of the last N ticks, for rollback: restore an older tick, apply corrected inputs
+// and step back to the present (see rollback()). Slots are reserved up front and reused. Simulation thread only
+class Rollback {
+    World& _world;
+    std::vector<WorldState> _ring;
+    // ticks saved so far, the newest is _ticks - 1
+    uint64_t _ticks = 0;
+
+    inline WorldState& _slot(const uint64_t tick) { return _ring[tick % _ring.size()]; }
+
+public:
+    // ships: how many to reserve room for in every slot
+    Rollback(World& world, const size_t ticks, const size_t ships) : _world(world), _ring(ticks) {
+        for (WorldState& state : _ring) { state.reserve(ships); }
+    }
+    Rollback(const Rollback&) = delete;
+    Rollback& operator=(const Rollback&) = delete;
+
+    // after every world step, overwrites the oldest tick once the ring is full
+    inline void save() { _world.save(_slot(_ticks++)); }
+    // false if there is no such tick
+    inline bool has(const uint64_t tick) const { return tick < _ticks && tick + _ring.size() >= _ticks; }
+    inline uint64_t newest() const { return _ticks - 1; }
+    inline uint64_t oldest() const { return _ticks > _ring.size() ? _ticks - _ring.size() : 0; }
+
+    // world back to how it was after tick, the ticks after it are forgotten. Checkpoints and retries
+    bool restore(const uint64_t tick) {
+        if (!has(tick)) LERRRET(false, "tick {} is not in the ring ({}..{})", tick, oldest(), newest());
+        _world.restore(_slot(tick));
+        _ticks = tick + 1;
+        return true;
+    }
+    // restores tick and steps again to the present: step(t) runs once for every tick t after it, it applies the inputs
+    // of t (possibly corrected since) and steps the world. The ring is refilled on the way
+    template <class F>
+    bool rollback(const uint64_t tick, F&& step) {
+        PROFILE_ZONE("Rollback::rollback");
+        const uint64_t present = _ticks;
+        if (!restore(tick)) return false;
+        while (_ticks < present) {
+            step(_ticks);
+            save();
+        }
+        return true;
+    }
+};
@@ -0,0 +1,219 @@
+#pragma once
+#include <sys/types.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <glm/trigonometric.hpp>
+#include <glm/vec2.hpp>
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "globals.hpp"
+#include "log.cpp"
+#include "pool.cpp"
+#include "static_geometry.cpp"
+#include "task_scheduler.cpp"
+#include "texture.cpp"
+#include "transform.cpp"
+#include "world.cpp"
+
+// The universe is cut into SECTOR_SIZE squares. Sectors near the focus are generated and baked on the scheduler
+// and built into the world a few shapes per tick, sectors left behind are torn down the same way,
+// so body count and memory depend on the load radius only. A sector is one StaticChunk in World::chunks
+// per SECTOR_SHAPES_PER_TICK merged boxes, the first one carries the geometry. Simulation thread only
+class Sectors {
+public:
+    // content of a sector as plain data, generated off the simulation thread. Pixels
+    struct Blueprint {
+        struct Wall {
+            // into the textures given to the constructor
+            uint8_t texture;
+            Transform transform;
+        };
+        std::vector<Wall> walls{};
+        // of the walls, see StaticGeometry. Physics units
+        glm::vec2 origin{};
+        std::vector<StaticGeometry::Box> boxes{};
+        std::shared_ptr<const StaticGeometry::Chunk> geometry{};
+    };
+    // deterministic for a seed and coords. widths: pixels, of the textures given to the constructor
+    static Blueprint generate(const uint seed, const glm::ivec2& coords, const std::vector<float>& widths) {
+        std::seed_seq seq{seed, uint(coords.x), uint(coords.y)};
+        std::mt19937 rng(seq);
+        std::uniform_real_distribution<float> along(0.0f, SECTOR_SIZE);
+        std::uniform_real_distribution<double> angle(0.0, glm::two_pi<double>());
+        const glm::vec2 origin = glm::vec2(coords) * float(SECTOR_SIZE);
+        Blueprint out{};
+        // a few clusters of walls per sector
+        const uint clusters = rng() % 4 + 1;
+        for (uint i = 0; i < clusters; i++) {
+            const glm::vec2 center = origin + glm::vec2(along(rng), along(rng));
+            // the player spawns at the origin
+            if (glm::length(center) < SECTOR_SIZE / 4.0) continue;
+            const uint8_t texture = rng() % widths.size();
+            const double rotation = angle(rng);
+            // tiles end to end, reaching 64 to 512 px past the first one
+            const float width = widths[texture];
+            const uint walls = 1 + uint(std::ceil(float(rng() % 8 + 1) * 64.0f / width));
+            for (uint j = 0; j < walls; j++) {
+                const glm::vec2 offset = glm::vec2(std::cos(rotation), std::sin(rotation)) * (float(j) * width);
+                out.walls.push_back({texture, Transform(center + offset, rotation)});
+            }
+        }
+        return out;
+    }
+
+private:
+    enum class State : uint8_t {
+        GENERATING,
+        BUILDING,
+        LOADED,
+        // out of range, torn down last chunk first
+        RETIRED,
+    };
+    struct Sector {
+        glm::ivec2 coords;
+        const Sectors* self;
+        State state = State::GENERATING;
+        // set by _generate() on a worker
+        std::atomic<bool> generated{false};
+        Blueprint blueprint{};
+        // in World::chunks, built so far
+        std::vector<Pool<StaticChunk>::Handle> chunks{};
+    };
+
+    World& _world;
+    TaskScheduler& _scheduler;
+    const std::vector<std::shared_ptr<Texture>> _textures;
+    // of _textures, pixels
+    std::vector<float> _widths{};
+    const uint _seed;
+    TaskScheduler::TaskGroup _generating{};
+    // ordered, so sectors are built and torn down in the same order every run
+    std::map<std::pair<int, int>, std::unique_ptr<Sector>> _sectors{};
+    size_t _walls = 0;
+    size_t _shapes = 0;
+    // boxes of the chunk being built
+    std::vector<StaticGeometry::Box> _boxes{};
+
+    static inline std::pair<int, int> _key(const glm::ivec2& coords) { return {coords.x, coords.y}; }
+    static inline int _distance(const glm::ivec2& a, const glm::ivec2& b) { return std::max(std::abs(a.x - b.x), std::abs(a.y - b.y)); }
+    static inline size_t _chunks_count(const Blueprint& blueprint) { return (blueprint.boxes.size() + SECTOR_SHAPES_PER_TICK - 1) / SECTOR_SHAPES_PER_TICK; }
+    // boxes of chunk i, at most SECTOR_SHAPES_PER_TICK
+    static inline size_t _shapes_of(const Blueprint& blueprint, const size_t i) {
+        return std::min<size_t>(SECTOR_SHAPES_PER_TICK, blueprint.boxes.size() - i * SECTOR_SHAPES_PER_TICK);
+    }
+
+    // false once budget is too small for the next chunk
+    bool _build_next(Sector& sector, int& budget) {
+        const Blueprint& blueprint = sector.blueprint;
+        const size_t i = sector.chunks.size();
+        const int shapes = _shapes_of(blueprint, i);
+        if (shapes > budget) return false;
+        const auto first = blueprint.boxes.begin() + i * SECTOR_SHAPES_PER_TICK;
+        _boxes.assign(first, first + shapes);
+        sector.chunks.push_back(_world.spawn_chunk(blueprint.origin, _boxes, i == 0 ? blueprint.geometry : nullptr));
+        budget -= shapes;
+        _shapes += shapes;
+        if (i == 0) _walls += blueprint.walls.size();
+        return true;
+    }
+    bool _tear_down_last(Sector& sector, int& budget) {
+        const Blueprint& blueprint = sector.blueprint;
+        const size_t i = sector.chunks.size() - 1;
+        const int shapes = _shapes_of(blueprint, i);
+        if (shapes > budget) return false;
+        _world.despawn(sector.chunks.back());
+        sector.chunks.pop_back();
+        budget -= shapes;
+        _shapes -= shapes;
+        if (i == 0) _walls -= blueprint.walls.size();
+        return true;
+    }
+
+    static void _generate(int, int, uint32_t, void* context) {
+        Sector& sector = *static_cast<Sector*>(context);
+        Blueprint& blueprint = sector.blueprint;
+        blueprint = generate(sector.self->_seed, sector.coords, sector.self->_widths);
+        std::vector<StaticGeometry::Tile> tiles{};
+        tiles.reserve(blueprint.walls.size());
+        for (const Blueprint::Wall& wall : blueprint.walls) { tiles.push_back(StaticGeometry::tile(*sector.self->_textures[wall.texture], wall.transform)); }
+        blueprint.origin = glm::vec2(sector.coords) * float(SECTOR_SIZE / ZOOM_FACTOR);
+        StaticGeometry::merge(tiles, blueprint.origin, blueprint.boxes);
+        blueprint.geometry = StaticGeometry::bake(std::move(tiles));
+        sector.generated.store(true, std::memory_order_release);
+    }
+
+public:
+    // waits for the sectors requested in a tick before building, so bodies spawn in the same ticks every run
+    // for the same focus path (recording and replay), at the cost of a stall on the first tick of a new sector
+    bool lockstep = false;
+
+    Sectors(const Sectors&) = delete;
+    Sectors& operator=(const Sectors&) = delete;
+    Sectors(World& world, TaskScheduler& scheduler, const std::vector<std::shared_ptr<Texture>>& textures, const uint seed = 1)
+        : _world(world), _scheduler(scheduler), _textures(textures), _seed(seed) {
+        // known before the pixels are, see ResourceManager::get_texture()
+        for (const std::shared_ptr<Texture>& texture : _textures) { _widths.push_back(texture->w()); }
+    }
+    ~Sectors() { _scheduler.wait(_generating); }
+
+    // once per tick. focus: physics units
+    void update(const glm::vec2& focus) {
+        const glm::ivec2 center(glm::floor(focus * float(ZOOM_FACTOR / SECTOR_SIZE)));
+        for (int x = -SECTOR_LOAD_RADIUS; x <= SECTOR_LOAD_RADIUS; x++) {
+            for (int y = -SECTOR_LOAD_RADIUS; y <= SECTOR_LOAD_RADIUS; y++) {
+                std::unique_ptr<Sector>& sector = _sectors[_key(center + glm::ivec2(x, y))];
+                if (!sector) {
+                    sector = std::make_unique<Sector>();
+                    sector->coords = center + glm::ivec2(x, y);
+                    sector->self = this;
+                    _scheduler.enqueue(_generating, &_generate, sector.get(), 1);
+                } else if (sector->state == State::RETIRED)
+                    sector->state = State::BUILDING;
+            }
+        }
+        if (lockstep) _scheduler.wait(_generating);
+
+        // no more than SECTOR_SHAPES_PER_TICK shapes created or destroyed, a chunk never has more
+        int budget = SECTOR_SHAPES_PER_TICK;
+        std::vector<Sector*> building{};
+        for (auto it = _sectors.begin(); it != _sectors.end();) {
+            Sector& sector = *it->second;
+            const int distance = _distance(sector.coords, center);
+            if (sector.state == State::GENERATING && sector.generated.load(std::memory_order_acquire)) sector.state = State::BUILDING;
+            if (sector.state != State::GENERATING && distance > SECTOR_UNLOAD_RADIUS) sector.state = State::RETIRED;
+            if (sector.state == State::RETIRED) {
+                while (!sector.chunks.empty() && _tear_down_last(sector, budget)) {}
+                if (sector.chunks.empty()) {
+                    LTRACE("sector {} {} unloaded", sector.coords.x, sector.coords.y);
+                    it = _sectors.erase(it);
+                    continue;
+                }
+            }
+            if (sector.state == State::BUILDING) building.push_back(&sector);
+            ++it;
+        }
+
+        // nearest first
+        std::sort(building.begin(), building.end(), [&](const Sector* a, const Sector* b) { return _distance(a->coords, center) < _distance(b->coords, center); });
+        for (Sector* sector : building) {
+            const Blueprint& blueprint = sector->blueprint;
+            while (sector->chunks.size() < _chunks_count(blueprint) && _build_next(*sector, budget)) {}
+            if (sector->chunks.size() < _chunks_count(blueprint)) break;
+            sector->state = State::LOADED;
+            LTRACE("sector {} {} loaded, {} walls in {} shapes", sector->coords.x, sector->coords.y, blueprint.walls.size(), blueprint.boxes.size());
+        }
+    }
+
+    inline uint seed() const { return _seed; }
+    inline size_t sectors_count() const { return _sectors.size(); }
+    inline size_t walls_count() const { return _walls; }
+    // of the loaded chunks, the broadphase proxies the walls cost
+    inline size_t shapes_count() const { return _shapes; }
+};
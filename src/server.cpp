@@ -0,0 +1,568 @@
+// dedicated authoritative server: clients send Ship::InputFrames over UDP and get the ships back as delta snapshots
+// against the newest one they acknowledged, prioritized by distance to their ship and cut to a bandwidth budget.
+//   turned_server [--port P] [--bots N] [--ships N] [--seconds S] [--budget bytes/s] [--timeout S] [--churn S] [--max-clients N] [--sweep]
+// --bots runs headless clients in this process over localhost, --sweep repeats the run for 1, 2, 4 ... N of them.
+// --churn makes one bot after another go silent every S seconds and join again from a new port,
+// so timed out ships free their pool slots and the next ships reuse them
+#include <box2d/box2d.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "fleet.cpp"
+#include "globals.hpp"
+#include "log.cpp"
+#include "net.cpp"
+#include "pool.cpp"
+#include "profiler.cpp"
+#include "resource_manager.cpp"
+#include "ship.cpp"
+#include "task_scheduler.cpp"
+#include "utils.cpp"
+#include "world.cpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+using clock_type = std::chrono::steady_clock;
+
+struct ServerOptions {
+    // 0 picks a free one
+    uint16_t port = 0;
+    size_t bots = 8;
+    // AI ships orbiting the center, replicated like the clients' ones
+    size_t ships = 500;
+    double seconds = 10.0;
+    // of silence before a client is dropped
+    double timeout = 5.0;
+    // seconds between bots rejoining, 0 = never
+    double churn = 0.0;
+    // HELLOs from new addresses are ignored beyond this many
+    size_t max_clients = 256;
+    // per client, bytes per second of snapshot payload
+    size_t budget = 32 * 1024;
+    uint seed = 1;
+    // 0 = every hardware thread
+    uint workers = 0;
+    bool sweep = false;
+};
+
+static ServerOptions parse_options(int argc, char** argv) {
+    ServerOptions out{};
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--sweep")) {
+            out.sweep = true;
+            continue;
+        }
+        if (i + 1 == argc) {
+            LWARN("option {} has no value", argv[i]);
+            break;
+        }
+        if (!std::strcmp(argv[i], "--port"))
+            out.port = std::strtoul(argv[i + 1], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--bots"))
+            out.bots = std::strtoul(argv[i + 1], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--ships"))
+            out.ships = std::strtoul(argv[i + 1], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--seconds"))
+            out.seconds = std::strtod(argv[i + 1], nullptr);
+        else if (!std::strcmp(argv[i], "--timeout"))
+            out.timeout = std::strtod(argv[i + 1], nullptr);
+        else if (!std::strcmp(argv[i], "--max-clients"))
+            out.max_clients = std::strtoul(argv[i + 1], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--churn"))
+            out.churn = std::strtod(argv[i + 1], nullptr);
+        else if (!std::strcmp(argv[i], "--budget"))
+            out.budget = std::strtoul(argv[i + 1], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--seed"))
+            out.seed = std::strtoul(argv[i + 1], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--workers"))
+            out.workers = std::strtoul(argv[i + 1], nullptr, 10);
+        else
+            LWARN("unknown option {}", argv[i]);
+        i++;
+    }
+    // every ship needs a pool index below NetProtocol::MAX_SHIPS
+    if (out.ships + out.max_clients > NetProtocol::MAX_SHIPS) {
+        out.max_clients = std::min<size_t>(out.max_clients, NetProtocol::MAX_SHIPS / 2);
+        out.ships = std::min<size_t>(out.ships, NetProtocol::MAX_SHIPS - out.max_clients);
+        LWARN("too many ships, using --ships {} --max-clients {}", out.ships, out.max_clients);
+    }
+    if (out.bots > out.max_clients) LWARN("--bots {} is more than --max-clients {}, the others are ignored", out.bots, out.max_clients);
+    return out;
+}
+
+// newest input of a remote client
+class RemoteController final : public Ship::IController {
+public:
+    Ship::InputFrame frame{};
+
+    void update(const Input& input) override {}
+    Ship::InputFrame get(const Ship& ship) override { return frame; }
+};
+
+class Server {
+public:
+    // physics units from the center, ships spawn inside
+    const float half_extent;
+
+    struct Stats {
+        std::vector<double> tick_us{};
+        std::vector<double> replicate_us{};
+        // per client per tick
+        std::vector<double> bytes{};
+        std::vector<double> entries{};
+    };
+    Stats stats{};
+    // ticks before this are not in stats, the first snapshots are full ones
+    uint32_t stats_from = 0;
+
+private:
+    // physics units, priority halves at this distance from the client's ship
+    constexpr static float PRIORITY_RADIUS = 16.0f;
+
+    struct Client {
+        sockaddr_in addr;
+        Pool<Ship>::Handle ship;
+        std::shared_ptr<RemoteController> controller;
+        // newest snapshot the client decoded
+        uint32_t acked = NetProtocol::NO_TICK;
+        clock_type::time_point heard;
+        NetHistory sent{};
+        // grows every tick a changed ship is not sent, by pool index
+        std::vector<float> priority{};
+    };
+    struct Candidate {
+        uint32_t index;
+        float priority;
+        NetProtocol::Entry kind;
+        // encoded, at most
+        uint32_t size;
+    };
+
+    ServerOptions _options;
+    TaskScheduler& _scheduler;
+    UdpSocket _socket{};
+    World _world;
+    Fleet _fleet{};
+    std::shared_ptr<Texture> _ship_texture;
+    std::vector<std::unique_ptr<Client>> _clients{};
+    uint32_t _tick = 0;
+    std::mt19937 _rng;
+    // every ship this tick, by pool index
+    std::vector<NetProtocol::Quantized> _current{};
+    std::vector<Candidate> _candidates{};
+    u_char _packet[NetProtocol::MAX_PACKET];
+
+    Client* _find(const sockaddr_in& addr) {
+        for (const std::unique_ptr<Client>& client : _clients) {
+            if (client->addr == addr) return client.get();
+        }
+        return nullptr;
+    }
+    Pool<Ship>::Handle _spawn_random() {
+        std::uniform_real_distribution<float> dist(-half_extent, half_extent);
+        return _world.spawn_ship(_ship_texture, Transform(glm::vec2(dist(_rng), dist(_rng)) * float(ZOOM_FACTOR), 0.0));
+    }
+    void _welcome(const Client& client) {
+        ByteWriter out(_packet, sizeof(_packet));
+        NetProtocol::put_header(out, NetProtocol::WELCOME);
+        out.put(client.ship.index);
+        _socket.send(client.addr, _packet, out.size());
+    }
+
+    void _receive() {
+        const clock_type::time_point now = clock_type::now();
+        sockaddr_in from;
+        u_char data[NetProtocol::MAX_PACKET];
+        while (const size_t size = _socket.receive(from, data, sizeof(data))) {
+            ByteReader in(data, size);
+            NetProtocol::Type type;
+            if (!NetProtocol::get_header(in, type)) continue;
+            Client* client = _find(from);
+            if (type == NetProtocol::HELLO) {
+                // every datagram from a new address would cost a ship otherwise
+                if (!client && _clients.size() >= _options.max_clients) continue;
+                if (!client) {
+                    _clients.push_back(std::make_unique<Client>());
+                    client = _clients.back().get();
+                    client->addr = from;
+                    client->ship = _spawn_random();
+                    client->controller = std::make_shared<RemoteController>();
+                    _world.ships.get(client->ship)->controller = client->controller;
+                    LDEBUG("client {}:{} joined, ship {}", inet_ntoa(from.sin_addr), ntohs(from.sin_port), client->ship.index);
+                }
+                client->heard = now;
+                // again for every HELLO, the first WELCOME may be lost
+                _welcome(*client);
+                continue;
+            }
+            if (type != NetProtocol::INPUT || !client) continue;
+            const uint32_t ack = in.get<uint32_t>();
+            Ship::InputFrame frame{};
+            frame.throttle = in.get<float>();
+            frame.slide = in.get<float>();
+            frame.lookat.x = in.get<float>();
+            frame.lookat.y = in.get<float>();
+            // one bad frame would spread NaN through the authoritative world
+            if (in.error() || !std::isfinite(frame.throttle) || !std::isfinite(frame.slide) || !std::isfinite(frame.lookat.x) || !std::isfinite(frame.lookat.y))
+                continue;
+            frame.throttle = std::clamp(frame.throttle, -1.0, 1.0);
+            frame.slide = std::clamp(frame.slide, -1.0, 1.0);
+            client->heard = now;
+            client->controller->frame = frame;
+            // datagrams reorder, keep the newest
+            if (ack != NetProtocol::NO_TICK && ack < _tick && (client->acked == NetProtocol::NO_TICK || ack > client->acked)) client->acked = ack;
+        }
+        for (size_t i = 0; i < _clients.size();) {
+            if (std::chrono::duration<double>(now - _clients[i]->heard).count() < _options.timeout) {
+                i++;
+                continue;
+            }
+            LDEBUG("client {}:{} timed out", inet_ntoa(_clients[i]->addr.sin_addr), ntohs(_clients[i]->addr.sin_port));
+            _world.despawn(_clients[i]->ship);
+            _clients[i] = std::move(_clients.back());
+            _clients.pop_back();
+        }
+    }
+
+    // NetProtocol::SNAPSHOT against the client's acked view, highest priority first until the budget is spent
+    size_t _send_snapshot(Client& client, size_t& entries) {
+        // the baseline's slot is about to be reused at HISTORY ticks of age
+        const bool has_baseline = client.acked != NetProtocol::NO_TICK && _tick - client.acked < NetProtocol::HISTORY;
+        const NetView* baseline = has_baseline ? client.sent.find(client.acked) : nullptr;
+        NetView& view = client.sent.begin(_tick, baseline);
+        const Ship* own = _world.ships.get(client.ship);
+        const glm::vec2 focus = own ? own->get_transform().pos : glm::vec2(0.0f);
+        if (client.priority.size() < _current.size()) client.priority.resize(_current.size(), 0.0f);
+
+        _candidates.clear();
+        for (uint32_t i = 0; i < view.ships.size(); i++) {
+            // a ship that took the slot over since is sent FULL below, which replaces the old one
+            if (view.ships[i].generation && (i >= _current.size() || !_current[i].generation))
+                _candidates.push_back({i, INFINITY, NetProtocol::REMOVED, uint32_t(ByteWriter::varint_size(i << 2))});
+        }
+        for (uint32_t i = 0; i < _current.size(); i++) {
+            const NetProtocol::Quantized& q = _current[i];
+            if (!q.generation) continue;
+            const NetProtocol::Quantized* known = view.get(i);
+            if (known && *known == q) {
+                client.priority[i] = 0.0f;
+                continue;
+            }
+            const glm::vec2 d = glm::vec2(q.x, q.y) / NetProtocol::POS_SCALE - focus;
+            client.priority[i] += 1.0f / (1.0f + glm::dot(d, d) / (PRIORITY_RADIUS * PRIORITY_RADIUS));
+            const float priority = i == client.ship.index ? INFINITY : client.priority[i];
+            // the index delta written is never larger than the index
+            size_t size = ByteWriter::varint_size(i << 2);
+            if (known && known->generation == q.generation) {
+                size += ByteWriter::varint_size(ByteWriter::zigzag(q.x - known->x)) + ByteWriter::varint_size(ByteWriter::zigzag(q.y - known->y)) +
+                        ByteWriter::varint_size(ByteWriter::zigzag(int16_t(uint16_t(q.angle - known->angle))));
+                _candidates.push_back({i, priority, NetProtocol::DELTA, uint32_t(size)});
+            } else {
+                size += ByteWriter::varint_size(q.generation) + ByteWriter::varint_size(ByteWriter::zigzag(q.x)) + ByteWriter::varint_size(ByteWriter::zigzag(q.y)) + 2;
+                _candidates.push_back({i, priority, NetProtocol::FULL, uint32_t(size)});
+            }
+        }
+
+        const size_t budget = std::min<size_t>(NetProtocol::MAX_PACKET, _options.budget / PHYSICS_RATE);
+        // header with the largest count varint
+        size_t size = 2 + 1 + 4 + 4 + 3;
+        // an entry takes at least 4 bytes, no more than this many fit
+        const size_t fit = std::min(_candidates.size(), budget / 4);
+        std::partial_sort(_candidates.begin(), _candidates.begin() + fit, _candidates.end(),
+                          [](const Candidate& a, const Candidate& b) { return a.priority > b.priority; });
+        size_t chosen = 0;
+        for (; chosen < fit && size + _candidates[chosen].size <= budget; chosen++) { size += _candidates[chosen].size; }
+        std::sort(_candidates.begin(), _candidates.begin() + chosen, [](const Candidate& a, const Candidate& b) { return a.index < b.index; });
+
+        ByteWriter out(_packet, sizeof(_packet));
+        NetProtocol::put_header(out, NetProtocol::SNAPSHOT);
+        out.put(_tick);
+        out.put(baseline ? client.acked : NetProtocol::NO_TICK);
+        out.put_varint(chosen);
+        for (size_t i = 0; i < chosen; i++) {
+            const Candidate& candidate = _candidates[i];
+            // one entry per index, the deltas would wrap otherwise
+            assert(!i || candidate.index > _candidates[i - 1].index);
+            const uint32_t delta = i ? candidate.index - _candidates[i - 1].index - 1 : candidate.index;
+            out.put_varint(delta << 2 | candidate.kind);
+            if (candidate.kind == NetProtocol::REMOVED) {
+                view.set(candidate.index, {});
+                continue;
+            }
+            const NetProtocol::Quantized& q = _current[candidate.index];
+            if (candidate.kind == NetProtocol::DELTA) {
+                const NetProtocol::Quantized& known = view.ships[candidate.index];
+                out.put_zigzag(q.x - known.x);
+                out.put_zigzag(q.y - known.y);
+                out.put_zigzag(int16_t(uint16_t(q.angle - known.angle)));
+            } else {
+                out.put_varint(q.generation);
+                out.put_zigzag(q.x);
+                out.put_zigzag(q.y);
+                out.put(q.angle);
+            }
+            view.set(candidate.index, q);
+            client.priority[candidate.index] = 0.0f;
+        }
+        _socket.send(client.addr, _packet, out.size());
+        entries = chosen;
+        return out.size();
+    }
+
+    void _replicate() {
+        PROFILE_ZONE("Server::_replicate");
+        _current.clear();
+        for (auto it = _world.ships.begin(); it != _world.ships.end(); ++it) {
+            const Pool<Ship>::Handle handle = it.handle();
+            if (handle.index >= _current.size()) _current.resize(handle.index + 1, {});
+            _current[handle.index] = NetProtocol::quantize(handle.generation, it->get_transform());
+        }
+        for (const std::unique_ptr<Client>& client : _clients) {
+            size_t entries;
+            const size_t bytes = _send_snapshot(*client, entries);
+            if (_tick < stats_from) continue;
+            stats.bytes.push_back(bytes);
+            stats.entries.push_back(entries);
+        }
+    }
+
+public:
+    Server(ResourceManager& resource_manager, TaskScheduler& scheduler, const ServerOptions& options)
+        : half_extent(std::max(16.0f, std::sqrt(float(options.ships + options.bots)) * 3.0f)),
+          _options(options),
+          _scheduler(scheduler),
+          _world(scheduler),
+          _ship_texture(resource_manager.get_texture("assets/ship01.png")),
+          _rng(options.seed) {
+        // every ship is near, clients can be anywhere
+        _world.far_radius = INFINITY;
+        _world.ships.reserve(options.ships + std::min(options.bots, options.max_clients));
+        for (size_t i = 0; i < options.ships; i++) { _fleet.add(_world, _spawn_random()); }
+        _fleet.order = Fleet::Order::ORBIT;
+        _fleet.params.orbit_radius = half_extent / 2.0f;
+    }
+
+    bool open() {
+        if (!_socket.open(_options.port, _options.bots ? "127.0.0.1" : "0.0.0.0")) return false;
+        LINFO("listening on port {}", _socket.port());
+        return true;
+    }
+    inline uint16_t port() const { return _socket.port(); }
+    inline size_t clients_count() const { return _clients.size(); }
+
+    void tick() {
+        PROFILE_ZONE("Server::tick");
+        const clock_type::time_point start = clock_type::now();
+        _receive();
+        _fleet.update(_world, PHYSICS_DT, &_scheduler);
+        _world.step(PHYSICS_DT);
+        const clock_type::time_point replicate_start = clock_type::now();
+        _replicate();
+        if (_tick >= stats_from) {
+            const clock_type::time_point end = clock_type::now();
+            stats.tick_us.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+            stats.replicate_us.push_back(std::chrono::duration<double, std::micro>(end - replicate_start).count());
+        }
+        _tick++;
+    }
+};
+
+// headless clients on one thread, each with its own socket. They wander to random points and decode every snapshot
+class Bots {
+    struct Bot {
+        UdpSocket socket{};
+        // pool index of the own ship, NO_TICK until welcomed
+        uint32_t ship = NetProtocol::NO_TICK;
+        NetHistory history{};
+        uint32_t newest = NetProtocol::NO_TICK;
+        glm::vec2 target{};
+    };
+    std::vector<std::unique_ptr<Bot>> _bots{};
+    sockaddr_in _server{};
+    const float _half_extent;
+    const double _churn;
+    // next to rejoin
+    size_t _churned = 0;
+    std::mt19937 _rng;
+    std::thread _thread{};
+    std::atomic<bool> _running{false};
+
+    void _retarget(Bot& bot) {
+        std::uniform_real_distribution<float> dist(-_half_extent, _half_extent);
+        bot.target = {dist(_rng), dist(_rng)};
+    }
+    // silent on the old port until the server times it out, a new client on a new one
+    void _rejoin(Bot& bot) {
+        if (!bot.socket.open()) return;
+        bot.ship = NetProtocol::NO_TICK;
+        bot.history = {};
+        bot.newest = NetProtocol::NO_TICK;
+        rejoined.fetch_add(1, std::memory_order_relaxed);
+    }
+    void _receive(Bot& bot) {
+        sockaddr_in from;
+        u_char data[NetProtocol::MAX_PACKET];
+        while (const size_t size = bot.socket.receive(from, data, sizeof(data))) {
+            ByteReader in(data, size);
+            NetProtocol::Type type;
+            if (!NetProtocol::get_header(in, type)) continue;
+            if (type == NetProtocol::WELCOME) {
+                bot.ship = in.get<uint32_t>();
+                continue;
+            }
+            uint32_t tick;
+            if (type != NetProtocol::SNAPSHOT || !read_snapshot(in, bot.history, tick)) {
+                rejected.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            decoded.fetch_add(1, std::memory_order_relaxed);
+            if (bot.newest == NetProtocol::NO_TICK || tick > bot.newest) bot.newest = tick;
+        }
+    }
+    void _send(Bot& bot) {
+        u_char data[64];
+        ByteWriter out(data, sizeof(data));
+        if (bot.ship == NetProtocol::NO_TICK) {
+            NetProtocol::put_header(out, NetProtocol::HELLO);
+            bot.socket.send(_server, data, out.size());
+            return;
+        }
+        const NetView* view = bot.history.find(bot.newest);
+        const NetProtocol::Quantized* own = view ? view->get(bot.ship) : nullptr;
+        if (own && glm::distance(NetProtocol::dequantize(*own).pos, bot.target) < 2.0f) _retarget(bot);
+        NetProtocol::put_header(out, NetProtocol::INPUT);
+        out.put(bot.newest);
+        out.put(1.0f);
+        out.put(0.0f);
+        out.put(bot.target.x);
+        out.put(bot.target.y);
+        bot.socket.send(_server, data, out.size());
+    }
+    void _loop() {
+        clock_type::time_point next = clock_type::now();
+        const clock_type::duration churn = std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(_churn));
+        clock_type::time_point next_churn = next + churn;
+        while (_running.load(std::memory_order_relaxed)) {
+            if (_churn > 0.0 && !_bots.empty() && next >= next_churn) {
+                _rejoin(*_bots[_churned++ % _bots.size()]);
+                next_churn += churn;
+            }
+            for (const std::unique_ptr<Bot>& bot : _bots) {
+                _receive(*bot);
+                _send(*bot);
+            }
+            next += std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(PHYSICS_DT));
+            std::this_thread::sleep_until(next);
+        }
+    }
+
+public:
+    // snapshots decoded and dropped (corrupt, or their baseline was gone), over all bots
+    std::atomic<uint64_t> decoded{0};
+    std::atomic<uint64_t> rejected{0};
+    std::atomic<uint64_t> rejoined{0};
+
+    // churn: seconds between one bot after another rejoining, 0 = never
+    Bots(const size_t count, const uint16_t port, const float half_extent, const double churn, const uint seed)
+        : _half_extent(half_extent), _churn(churn), _rng(seed) {
+        _server.sin_family = AF_INET;
+        _server.sin_port = htons(port);
+        inet_pton(AF_INET, "127.0.0.1", &_server.sin_addr);
+        for (size_t i = 0; i < count; i++) {
+            _bots.push_back(std::make_unique<Bot>());
+            if (!_bots.back()->socket.open()) {
+                _bots.pop_back();
+                continue;
+            }
+            _retarget(*_bots.back());
+        }
+    }
+    Bots(const Bots&) = delete;
+    Bots& operator=(const Bots&) = delete;
+    ~Bots() { stop(); }
+
+    void start() {
+        _running = true;
+        _thread = std::thread(&Bots::_loop, this);
+    }
+    void stop() {
+        _running = false;
+        if (_thread.joinable()) _thread.join();
+    }
+    inline size_t size() const { return _bots.size(); }
+};
+
+struct RunResult {
+    size_t clients;
+    Server::Stats stats;
+    uint64_t decoded, rejected, rejoined;
+};
+
+// real time at PHYSICS_RATE, like a dedicated server would tick
+static bool run(ResourceManager& resource_manager, const ServerOptions& options, RunResult& out) {
+    TaskScheduler scheduler(options.workers);
+    Server server(resource_manager, scheduler, options);
+    if (!server.open()) return false;
+    // a second to connect and send the first full snapshots
+    server.stats_from = PHYSICS_RATE;
+    Bots bots(options.bots, server.port(), server.half_extent, options.churn, options.seed + 1);
+    bots.start();
+    const size_t ticks = options.seconds * PHYSICS_RATE;
+    clock_type::time_point next = clock_type::now();
+    for (size_t tick = 0; options.seconds <= 0.0 || tick < ticks; tick++) {
+        server.tick();
+        next += std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(PHYSICS_DT));
+        std::this_thread::sleep_until(next);
+    }
+    bots.stop();
+    out = {server.clients_count(), std::move(server.stats), bots.decoded.load(), bots.rejected.load(), bots.rejoined.load()};
+    return true;
+}
+
+static void report(RunResult& result) {
+    double bytes = 0.0;
+    for (const double b : result.stats.bytes) { bytes += b; }
+    const double mean = result.stats.bytes.empty() ? 0.0 : bytes / result.stats.bytes.size();
+    LINFO("{:>7} | {:>11.1f} | {:>6.1f} | {:>12.1f} | {:>10.1f} | {:>6.0f} | {:>11.1f} | {}/{}", result.clients, percentile(result.stats.tick_us, 0.5),
+          percentile(result.stats.tick_us, 0.99), percentile(result.stats.replicate_us, 0.5), mean, percentile(result.stats.bytes, 0.99),
+          percentile(result.stats.entries, 0.5), result.rejected, result.decoded);
+    if (result.rejoined) LINFO("{:>7} bots rejoined from a new port", result.rejoined);
+}
+
+int main(int argc, char** argv) {
+    std::filesystem::current_path(std::filesystem::canonical("/proc/self/exe").parent_path());
+    _init_log(spdlog::level::info);
+    const ServerOptions options = parse_options(argc, argv);
+    LINFO("{} server: {} ships, {} bots, budget {} B/s per client", PROJECT_NAME_VERSION, options.ships, options.bots, options.budget);
+
+    ResourceManager resource_manager{};
+    std::vector<size_t> counts{};
+    if (options.sweep) {
+        for (size_t bots = 1; bots < options.bots; bots *= 2) { counts.push_back(bots); }
+    }
+    counts.push_back(options.bots);
+
+    const char* header = "clients | tick p50 us | p99 us | replicate us | B/tick/cl | p99 B | ships/tick | dropped/decoded";
+    LINFO(header);
+    for (const size_t bots : counts) {
+        ServerOptions run_options = options;
+        run_options.bots = bots;
+        RunResult result{};
+        if (!run(resource_manager, run_options, result)) return 1;
+        report(result);
+    }
+    PROFILE_DUMP();
+    return 0;
+}
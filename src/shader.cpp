@@ -4,72 +4,145 @@
 #include <sys/types.h>
 
 #include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+#include <string>
+#include <vector>
 
+#include "hash.hpp"
 #include "log.cpp"
+#include "shaders.hpp"
 
 class Shader {
     uint _id;
+    int _locations[size_t(Uniform::COUNT)];
 
 public:
-    Shader(const char* vertex_src, const char* fragment_src) {
-        uint vert, frag;
+    // linked program binaries, keyed by sources and driver
+    constexpr static const char* CACHE_DIR = "cache/shaders";
+
+private:
+    static bool _check(const uint object, const GLenum status, const char* what) {
         int success;
         char logbuf[512];
+        if (status == GL_LINK_STATUS)
+            glGetProgramiv(object, status, &success);
+        else
+            glGetShaderiv(object, status, &success);
+        if (!success) {
+            if (status == GL_LINK_STATUS)
+                glGetProgramInfoLog(object, sizeof(logbuf), NULL, logbuf);
+            else
+                glGetShaderInfoLog(object, sizeof(logbuf), NULL, logbuf);
+            LCRIT("{} failed ({}): {:.{}}", what, success, logbuf, sizeof(logbuf));
+        }
+        return success;
+    }
+
+    bool _compile(const char* vertex_src, const char* fragment_src, const bool retrievable) {
+        uint vert, frag;
         // Compile vertex shader
         vert = glCreateShader(GL_VERTEX_SHADER);
         glShaderSource(vert, 1, &vertex_src, NULL);
         glCompileShader(vert);
-        // error check
-        glGetShaderiv(vert, GL_COMPILE_STATUS, &success);
-        if (!success) {
-            glGetShaderInfoLog(vert, sizeof(logbuf), NULL, logbuf);
-            spdlog::critical("vertex shader compilation failed ({}): {:.{}}", success, logbuf, sizeof(logbuf));
-        }
+        _check(vert, GL_COMPILE_STATUS, "vertex shader compilation");
 
         // Compile fragment shader
         frag = glCreateShader(GL_FRAGMENT_SHADER);
         glShaderSource(frag, 1, &fragment_src, NULL);
         glCompileShader(frag);
-        // error check
-        glGetShaderiv(frag, GL_COMPILE_STATUS, &success);
-        if (!success) {
-            glGetShaderInfoLog(frag, sizeof(logbuf), NULL, logbuf);
-            LCRIT("fragment shader compilation failed ({}): {:.{}}", success, logbuf, sizeof(logbuf));
-        }
+        _check(frag, GL_COMPILE_STATUS, "fragment shader compilation");
 
         // Link to shader program
-        _id = glCreateProgram();
+        if (retrievable) glProgramParameteri(_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
         glAttachShader(_id, vert);
         glAttachShader(_id, frag);
         glLinkProgram(_id);
-        // error check
-        glGetProgramiv(_id, GL_LINK_STATUS, &success);
-        if (!success) {
-            glGetProgramInfoLog(_id, sizeof(logbuf), NULL, logbuf);
-            LCRIT("shader program linking failed ({}): {:.{}}", success, logbuf, sizeof(logbuf));
-        }
+        const bool success = _check(_id, GL_LINK_STATUS, "shader program linking");
 
-        if (success != 1)
-            LWARN("SHADER {} ({} {}) NOT COMPILED SUCCESSFULLY ({})", _id, success, vert, frag);
+        if (!success)
+            LWARN("SHADER {} ({} {}) NOT COMPILED SUCCESSFULLY", _id, vert, frag);
         else
-            LTRACE("SHADER {} ({} {}) COMPILED SUCCESSFULLY ({})", _id, success, vert, frag);
+            LTRACE("SHADER {} ({} {}) COMPILED SUCCESSFULLY", _id, vert, frag);
 
+        glDetachShader(_id, vert);
+        glDetachShader(_id, frag);
         glDeleteShader(vert);
         glDeleteShader(frag);
+        return success;
+    }
+
+    static std::filesystem::path _cache_path(const char* vertex_src, const char* fragment_src) {
+        uint64_t key = fnv1a(vertex_src);
+        key = fnv1a(fragment_src, key);
+        for (const GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) { key = fnv1a(reinterpret_cast<const char*>(glGetString(name)), key); }
+        char filename[32];
+        std::snprintf(filename, sizeof(filename), "%016lx.bin", static_cast<unsigned long>(key));
+        return std::filesystem::path(CACHE_DIR) / filename;
+    }
+    // file: GLenum binary format, then the binary
+    bool _load_binary(const std::filesystem::path& path) {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file) return false;
+        const std::streamsize size = file.tellg();
+        if (size <= std::streamsize(sizeof(GLenum))) return false;
+        std::vector<char> data(size);
+        file.seekg(0);
+        if (!file.read(data.data(), size)) return false;
+        GLenum format;
+        std::memcpy(&format, data.data(), sizeof(format));
+        glProgramBinary(_id, format, data.data() + sizeof(format), size - sizeof(format));
+        int success;
+        glGetProgramiv(_id, GL_LINK_STATUS, &success);
+        return success;
+    }
+    void _store_binary(const std::filesystem::path& path) const {
+        int length = 0;
+        glGetProgramiv(_id, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0) return;
+        std::vector<char> data(sizeof(GLenum) + length);
+        GLenum format;
+        glGetProgramBinary(_id, length, nullptr, &format, data.data() + sizeof(format));
+        std::memcpy(data.data(), &format, sizeof(format));
+        std::error_code error;
+        std::filesystem::create_directories(path.parent_path(), error);
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file.write(data.data(), data.size())) LWARN("failed to write shader cache {}", path.c_str());
+    }
+    static bool _binaries_supported() {
+        int formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0;
+    }
+
+public:
+    Shader(const char* vertex_src, const char* fragment_src) {
+        _id = glCreateProgram();
+        const bool cache = _binaries_supported();
+        const std::filesystem::path path = cache ? _cache_path(vertex_src, fragment_src) : std::filesystem::path{};
+        if (cache && _load_binary(path))
+            LTRACE("SHADER {} loaded from {}", _id, path.c_str());
+        else {
+            // a rejected binary (driver update) leaves the program unusable, start over
+            glDeleteProgram(_id);
+            _id = glCreateProgram();
+            if (_compile(vertex_src, fragment_src, cache) && cache) _store_binary(path);
+        }
+        for (size_t i = 0; i < size_t(Uniform::COUNT); i++) { _locations[i] = glGetUniformLocation(_id, UNIFORM_NAMES[i]); }
     }
     Shader(const Shader&) = delete;
     Shader& operator=(const Shader&) = delete;
+    ~Shader() { glDeleteProgram(_id); }
 
     inline void use() const { glUseProgram(_id); }
-    // TODO: cache uniform location somehow
-    inline void set_mat4(const char* path, const glm::mat4x4& data) {
-        int loc = glGetUniformLocation(_id, path);
-        glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(data));
-    }
-    inline void set_int(const char* path, const int data) {
-        int loc = glGetUniformLocation(_id, path);
-        glUniform1i(loc, data);
-    }
+    inline void set_mat4(const Uniform uniform, const glm::mat4x4& data) { glUniformMatrix4fv(_locations[size_t(uniform)], 1, GL_FALSE, glm::value_ptr(data)); }
+    inline void set_int(const Uniform uniform, const int data) { glUniform1i(_locations[size_t(uniform)], data); }
+    inline void set_vec2(const Uniform uniform, const glm::vec2& data) { glUniform2fv(_locations[size_t(uniform)], 1, glm::value_ptr(data)); }
+    inline void set_vec4(const Uniform uniform, const glm::vec4& data) { glUniform4fv(_locations[size_t(uniform)], 1, glm::value_ptr(data)); }
 };
@@ -1,12 +1,47 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
+
+// every uniform used by the shaders below. Shader resolves all of them once after linking,
+// missing ones get location -1 and are ignored by GL
+enum class Uniform : uint8_t {
+    VP,
+    SPRITE,
+    SIZE,
+    TINT,
+    COUNT
+};
+constexpr static const char* UNIFORM_NAMES[size_t(Uniform::COUNT)] = {"VP", "Sprite", "Size", "Tint"};
+
 constexpr static const char* VERTEX_SHADER_2D = R"(
 #version 330 core
 layout (location = 0) in vec2 aPos;
 layout (location = 1) in vec2 aTexCoord;
-uniform mat4 MVP;
+// per-instance (see Sprite::Instance)
+layout (location = 2) in vec2 iPos;
+layout (location = 3) in vec2 iRot;
+layout (location = 4) in vec2 iSize;
+layout (location = 5) in vec4 iUV;
+uniform mat4 VP;
 out vec2 TexCoord;
 void main(){
-    gl_Position = MVP * vec4(aPos, 0.0, 1.0);
+    // same model matrix Sprite used to build on the CPU: scale, rotate, translate
+    vec2 p = aPos * iSize;
+    p = vec2(p.x * iRot.x + p.y * iRot.y, p.y * iRot.x - p.x * iRot.y);
+    gl_Position = VP * vec4(p + iPos, 0.0, 1.0);
+    TexCoord = iUV.xy + aTexCoord * iUV.zw;
+}
+)";
+
+// vertices already in world space with final UVs, see StaticBatch
+constexpr static const char* VERTEX_SHADER_2D_STATIC = R"(
+#version 330 core
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec2 aTexCoord;
+uniform mat4 VP;
+out vec2 TexCoord;
+void main(){
+    gl_Position = VP * vec4(aPos, 0.0, 1.0);
     TexCoord = aTexCoord;
 }
 )";
@@ -30,3 +65,32 @@ void main(){
     Color = vec4(1.0, 1.0, 1.0, 1.0);
 }
 )";
+
+// point sprites straight from ParticleSystem's SoA arrays, one attribute per array
+constexpr static const char* VERTEX_SHADER_PARTICLE = R"(
+#version 330 core
+layout (location = 0) in float aX;
+layout (location = 1) in float aY;
+layout (location = 2) in float aFade;
+uniform mat4 VP;
+// diameter at death and at birth, pixels
+uniform vec2 Size;
+out float Fade;
+void main(){
+    gl_Position = VP * vec4(aX, aY, 0.0, 1.0);
+    gl_PointSize = mix(Size.x, Size.y, aFade);
+    Fade = aFade;
+}
+)";
+
+constexpr static const char* FRAGMENT_SHADER_PARTICLE = R"(
+#version 330 core
+out vec4 Color;
+in float Fade;
+uniform vec4 Tint;
+void main(){
+    // round with a soft edge
+    float d = length(gl_PointCoord - vec2(0.5)) * 2.0;
+    Color = vec4(Tint.rgb, Tint.a * Fade * clamp(1.0 - d, 0.0, 1.0));
+}
+)";
@@ -1,3 +1,4 @@
+#pragma once
 #include <box2d/box2d.h>
 #include <box2d/collision.h>
 #include <box2d/id.h>
@@ -10,9 +11,11 @@
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/rotate_vector.hpp>
 #include <memory>
+#include <vector>
 
 #include "body_factory.cpp"
 #include "input.cpp"
+#include "particles.cpp"
 #include "sprite.cpp"
 #include "texture.cpp"
 #include "utils.cpp"
@@ -35,11 +38,28 @@ public:
     };
     class IController : public IControllerBase {
     public:
+        // ships near the focus are steered from outside in batches (see Fleet), get() then only drives the far tier
+        bool batched = false;
         // called from object's physics()
         virtual Ship::InputFrame get(const Ship& ship) = 0;
+
+        // rollback (see WorldState): up to STATE_SIZE bytes that get() depends on, false if there are none
+        constexpr static size_t STATE_SIZE = 32;
+        virtual bool save_state(u_char* out) const { return false; }
+        virtual void load_state(const u_char* in) {}
+    };
+    // what Box2D knows about a flying body, see World::save()
+    struct BodyState {
+        b2Transform transform;
+        b2Vec2 linear;
+        float angular;
+        bool awake;
     };
 
     std::shared_ptr<IController> controller{};
+    // exhaust particles per second at full thrust, see physics()
+    float exhaust_rate = 400.0f;
+    uint8_t exhaust_material = 0;
 
 private:
     b2BodyId _body_id;
@@ -47,37 +67,109 @@ private:
 
     double acceleration{};
     double angular_max_speed{};
+    bool _far = false;
+    // particles owed to the exhaust, carried between ticks
+    float _exhaust = 0.0f;
+
+    // velocity change in physics units
+    glm::vec2 _thrust(const InputFrame& inputs, const b2Rot& q, const double& dt) const {
+        glm::vec2 input = limit_length(glm::vec2(inputs.slide, inputs.throttle), 1.0f) * float(acceleration) * float(dt);
+        return glm::vec2(input.x * q.c + input.y * q.s, input.y * q.c - input.x * q.s) / float(ZOOM_FACTOR);
+    }
+    // out of the back of the hull, against dv
+    void _emit_exhaust(const glm::vec2& pos, const glm::vec2& vel, const glm::vec2& dv, const double& dt, std::vector<ParticleBurst>& out) {
+        const float length = glm::length(dv);
+        if (length <= 0.0f) return;
+        // 0..1 of full thrust
+        const float thrust = length * float(ZOOM_FACTOR) / float(acceleration * dt);
+        _exhaust += exhaust_rate * thrust * float(dt);
+        const uint16_t count = _exhaust;
+        if (count == 0) return;
+        _exhaust -= count;
+        const glm::vec2 dir = -dv / length;
+        const glm::vec2 size = _sprite.get_size();
+        out.push_back({pos + dir * (size.x + size.y) / 4.0f, vel, dir, 3.0f, 0.3f, float(dt), count, exhaust_material});
+    }
 
 public:
+    // rotation that points the ship from `from` at `at`, false if they are too close to tell
+    static inline bool look_at(const glm::vec2& from, const glm::vec2& at, b2Rot& out) {
+        const glm::vec2 dir = glm::normalize(at - from);
+        if (!valid_vec2(dir)) return false;
+        out = {dir.y, dir.x};
+        return true;
+    }
+
     const Transform get_transform() const { return b2Body_GetTransform(_body_id); }
     void set_transform(const Transform& other) { b2Body_SetTransform(_body_id, {other.pos.x, other.pos.y}, other.rot); };
 
-    void physics(const double& dt) {
+    // applies controller input, runs before the world step.
+    // the sprite is synced from the body move events afterwards (see World::step()).
+    // exhaust: bursts of engine particles are appended to it, nullptr for none
+    void physics(const double& dt, std::vector<ParticleBurst>* exhaust = nullptr) {
         InputFrame inputs = controller->get(*this);
-        Transform transform = get_transform();
+        const Transform transform = get_transform();
         b2Vec2 vel = b2Body_GetLinearVelocity(_body_id);
-        vel.x *= ZOOM_FACTOR;
-        vel.y *= ZOOM_FACTOR;
-
-        const b2Rot& q = transform.rot;
-        glm::vec2 input = limit_length(glm::vec2(inputs.slide, inputs.throttle), 1.0f) * float(acceleration) * float(dt);
-        vel.x += input.x * q.c + input.y * q.s;
-        vel.y -= input.x * q.s - input.y * q.c;
-
-        vel.x /= ZOOM_FACTOR;
-        vel.y /= ZOOM_FACTOR;
+        const glm::vec2 dv = _thrust(inputs, transform.rot, dt);
+        vel.x += dv.x;
+        vel.y += dv.y;
+        if (exhaust) _emit_exhaust(transform.pos, {vel.x, vel.y}, dv, dt, *exhaust);
 
         b2Body_SetLinearVelocity(_body_id, vel);
-        glm::vec2 rot = glm::normalize(inputs.lookat - get_transform().pos);
-        if (valid_vec2(rot)) b2Body_SetTransform(_body_id, {transform.pos.x, transform.pos.y}, {rot.y, rot.x});
+        b2Rot rot;
+        if (look_at(transform.pos, inputs.lookat, rot)) b2Body_SetTransform(_body_id, {transform.pos.x, transform.pos.y}, rot);
+    }
+
+    inline BodyState save() const {
+        return {b2Body_GetTransform(_body_id), b2Body_GetLinearVelocity(_body_id), b2Body_GetAngularVelocity(_body_id), b2Body_IsAwake(_body_id)};
+    }
+    // the sprite snaps to it, there is nothing to interpolate from
+    void restore(const BodyState& state) {
+        b2Body_SetTransform(_body_id, state.transform.p, state.transform.q);
+        b2Body_SetLinearVelocity(_body_id, state.linear);
+        b2Body_SetAngularVelocity(_body_id, state.angular);
+        b2Body_SetAwake(_body_id, state.awake);
+        _sprite.snap_transform(state.transform);
+    }
 
-        _sprite.transform = get_transform();
+    // far tier (see FarSimulation): the body is disabled and its state lives outside of Box2D
+    inline bool is_far() const { return _far; }
+    void demote() {
+        b2Body_Disable(_body_id);
+        _far = true;
     }
+    void promote(const glm::vec2& vel) {
+        b2Body_Enable(_body_id);
+        b2Body_SetLinearVelocity(_body_id, {vel.x, vel.y});
+        _far = false;
+    }
+    // same controls as physics(), applied to the far tier state instead of the body
+    void physics_far(const double& dt, const glm::vec2& pos, glm::vec2& vel, b2Rot& rot) {
+        if (!controller) return;
+        InputFrame inputs = controller->get(*this);
+        vel += _thrust(inputs, rot, dt);
+        look_at(pos, inputs.lookat, rot);
+    }
+    // disabled bodies have no broadphase proxies, so moving them is cheap. The sprite is left to set_far_sprite()
+    inline void set_far_transform(const Transform& transform) { b2Body_SetTransform(_body_id, {transform.pos.x, transform.pos.y}, transform.rot); }
+    // every tick, the far tier steps less often than the render interpolates
+    inline void set_far_sprite(const Transform& transform) { _sprite.set_transform(transform); }
+    inline glm::vec2 get_velocity() const {
+        const b2Vec2 vel = b2Body_GetLinearVelocity(_body_id);
+        return {vel.x, vel.y};
+    }
+    // for batched controllers, physics units
+    inline void set_velocity(const glm::vec2& vel) { b2Body_SetLinearVelocity(_body_id, {vel.x, vel.y}); }
+    // pixels per second squared
+    inline double get_acceleration() const { return acceleration; }
+    // radians per second
+    inline double get_angular_max_speed() const { return angular_max_speed; }
 
     // gets transform from constructed body
     Ship(const std::shared_ptr<Texture>& texture, b2BodyId&& body, const double& acceleration = 100.0, const double& angular_max_speed = glm::tau<double>())
         : _body_id(body), _sprite(texture, get_transform()), acceleration(acceleration), angular_max_speed(angular_max_speed) {
         b2Body_SetMotionLocks(_body_id, {false, false, true});
+        b2Body_SetUserData(_body_id, &_sprite);
     }
     // constructs the body in transform
     Ship(const std::shared_ptr<Texture>& texture, const b2WorldId world, const Transform& transform, const double& acceleration = 100.0,
@@ -87,6 +179,14 @@ public:
           acceleration(acceleration),
           angular_max_speed(angular_max_speed) {
         b2Body_SetMotionLocks(_body_id, {false, false, true});
+        b2Body_SetUserData(_body_id, &_sprite);
+    }
+    // body user data points at _sprite
+    Ship(const Ship&) = delete;
+    Ship& operator=(const Ship&) = delete;
+    // owns the body, nothing to do if the world is gone already
+    ~Ship() {
+        if (b2Body_IsValid(_body_id)) b2DestroyBody(_body_id);
     }
 
 public:
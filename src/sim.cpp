@@ -0,0 +1,290 @@
+// headless simulation: no window, no GL, textures are never decoded.
+// builds an arena of walls with N AI ships inside and steps it as fast as possible
+#include <box2d/box2d.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "fleet.cpp"
+#include "globals.hpp"
+#include "log.cpp"
+#include "profiler.cpp"
+#include "replay.cpp"
+#include "resource_manager.cpp"
+#include "rollback.cpp"
+#include "sectors.cpp"
+#include "ship.cpp"
+#include "task_scheduler.cpp"
+#include "utils.cpp"
+#include "world.cpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+// flies towards a random point inside the arena, picks a new one when close
+class WanderController final : public Ship::IController {
+    std::mt19937& _rng;
+    const float _half_extent;
+    glm::vec2 _target{};
+
+    void _retarget() {
+        std::uniform_real_distribution<float> dist(-_half_extent, _half_extent);
+        _target = {dist(_rng), dist(_rng)};
+    }
+
+public:
+    WanderController(std::mt19937& rng, const float half_extent) : _rng(rng), _half_extent(half_extent) { _retarget(); }
+    void update(const Input& input) override {}
+    Ship::InputFrame get(const Ship& ship) override {
+        if (glm::distance(ship.get_transform().pos, _target) < 1.0f) _retarget();
+        return {1.0, 0.0, _target};
+    }
+    // the shared rng is not part of it, targets picked after a rollback differ
+    bool save_state(u_char* out) const override {
+        std::memcpy(out, &_target, sizeof(_target));
+        return true;
+    }
+    void load_state(const u_char* in) override { std::memcpy(&_target, in, sizeof(_target)); }
+};
+
+struct SimOptions {
+    size_t ships = 1000;
+    size_t ticks = 6000;
+    uint seed = 1;
+    // pixels from the arena center, ships beyond it run in the far tier
+    float far_radius = FAR_SIMULATION_RADIUS;
+    // 0 = every hardware thread
+    uint workers = 0;
+    // pixels between spawned ships, ship radius is 28
+    float spacing = 96.0f;
+    // compare b2World_Step on 1, 2, 4 ... workers instead of a single run
+    bool scaling = false;
+    // every ship orbits the center in one batched Fleet instead of wandering on its own
+    bool fleet = false;
+    // recording made with main --record, replayed instead of the arena
+    const char* replay = nullptr;
+    // every this many ticks, roll back as many and simulate them again. 0 = never
+    size_t rollback = 0;
+};
+
+static SimOptions parse_options(int argc, char** argv) {
+    SimOptions out{};
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--scaling")) {
+            out.scaling = true;
+            continue;
+        }
+        if (!std::strcmp(argv[i], "--fleet")) {
+            out.fleet = true;
+            continue;
+        }
+        if (i + 1 == argc) {
+            LWARN("option {} has no value", argv[i]);
+            break;
+        }
+        if (!std::strcmp(argv[i], "--ships"))
+            out.ships = std::strtoul(argv[i + 1], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--ticks"))
+            out.ticks = std::strtoul(argv[i + 1], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--seed"))
+            out.seed = std::strtoul(argv[i + 1], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--far-radius"))
+            out.far_radius = std::strtof(argv[i + 1], nullptr);
+        else if (!std::strcmp(argv[i], "--workers"))
+            out.workers = std::strtoul(argv[i + 1], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--spacing"))
+            out.spacing = std::strtof(argv[i + 1], nullptr);
+        else if (!std::strcmp(argv[i], "--replay"))
+            out.replay = argv[i + 1];
+        else if (!std::strcmp(argv[i], "--rollback"))
+            out.rollback = std::strtoul(argv[i + 1], nullptr, 10);
+        else
+            LWARN("unknown option {}", argv[i]);
+        i++;
+    }
+    return out;
+}
+
+// square arena made of wall tiles, big enough to hold every ship on a grid
+class Arena {
+    std::mt19937 _rng;
+
+public:
+    TaskScheduler& scheduler;
+    World world;
+    Fleet fleet{};
+
+    Arena(ResourceManager& resource_manager, TaskScheduler& scheduler, const SimOptions& options)
+        : _rng(options.seed), scheduler(scheduler), world(scheduler) {
+        world.far_radius = options.far_radius;
+        const std::shared_ptr<Texture> wall_texture = resource_manager.get_texture("assets/wall02.png");
+        const float tile = wall_texture->w();
+        const size_t grid = std::ceil(std::sqrt(double(options.ships)));
+        const size_t tiles_per_side = std::max<size_t>(2, std::ceil(grid * options.spacing / tile) + 1);
+        const float half_extent = tiles_per_side * tile / 2.0f;
+        std::vector<StaticGeometry::Tile> tiles{};
+        for (size_t i = 0; i < tiles_per_side; i++) {
+            const float along = -half_extent + tile * (i + 0.5f);
+            tiles.push_back(StaticGeometry::tile(*wall_texture, Transform({along, -half_extent}, 0.0)));
+            tiles.push_back(StaticGeometry::tile(*wall_texture, Transform({along, half_extent}, 0.0)));
+            tiles.push_back(StaticGeometry::tile(*wall_texture, Transform({-half_extent, along}, glm::radians(90.0))));
+            tiles.push_back(StaticGeometry::tile(*wall_texture, Transform({half_extent, along}, glm::radians(90.0))));
+        }
+        // every side merges into a single box
+        world.spawn_chunk(std::move(tiles));
+
+        const std::shared_ptr<Texture> ship_texture = resource_manager.get_texture("assets/ship01.png");
+        world.ships.reserve(options.ships);
+        for (size_t i = 0; i < options.ships; i++) {
+            const glm::vec2 pos = glm::vec2(float(i % grid), float(i / grid)) * options.spacing - glm::vec2(grid * options.spacing / 2.0f);
+            const Pool<Ship>::Handle handle = world.spawn_ship(ship_texture, Transform(pos, 0.0));
+            if (options.fleet) {
+                fleet.add(world, handle);
+                continue;
+            }
+            world.ships.get(handle)->controller = std::make_shared<WanderController>(_rng, half_extent / float(ZOOM_FACTOR));
+        }
+        fleet.order = Fleet::Order::ORBIT;
+        fleet.params.orbit_radius = half_extent / float(ZOOM_FACTOR) / 2.0f;
+    }
+};
+
+struct RunResult {
+    double ticks_per_second;
+    // whole tick
+    std::vector<double> tick_us;
+    // b2World_Step only, from b2World_GetProfile()
+    std::vector<double> step_us;
+    // Rollback::save() of every tick and whole rollbacks, with --rollback
+    std::vector<double> save_us;
+    std::vector<double> rollback_us;
+};
+
+static RunResult run(Arena& arena, const size_t ticks, const size_t rollback = 0) {
+    using clock = std::chrono::steady_clock;
+    RunResult out{};
+    out.tick_us.reserve(ticks);
+    out.step_us.reserve(ticks);
+    Rollback ring(arena.world, rollback + 1, arena.world.ships.size());
+    const auto step = [&](uint64_t) {
+        arena.fleet.update(arena.world, PHYSICS_DT, &arena.scheduler);
+        arena.world.step(PHYSICS_DT);
+    };
+    const clock::time_point start = clock::now();
+    for (size_t tick = 0; tick < ticks; tick++) {
+        const clock::time_point tick_start = clock::now();
+        step(tick);
+        out.tick_us.push_back(std::chrono::duration<double, std::micro>(clock::now() - tick_start).count());
+        out.step_us.push_back(b2World_GetProfile(arena.world.get_id()).step * 1000.0);
+        if (!rollback) continue;
+        const clock::time_point save_start = clock::now();
+        ring.save();
+        out.save_us.push_back(std::chrono::duration<double, std::micro>(clock::now() - save_start).count());
+        // like a correction arriving rollback ticks late
+        if (ring.newest() < rollback || ring.newest() % rollback) continue;
+        const clock::time_point rollback_start = clock::now();
+        ring.rollback(ring.newest() - rollback, step);
+        out.rollback_us.push_back(std::chrono::duration<double, std::micro>(clock::now() - rollback_start).count());
+    }
+    out.ticks_per_second = ticks / std::chrono::duration<double>(clock::now() - start).count();
+    return out;
+}
+
+// rebuilds the recorded session and steps it like Game::process_physics() does, as fast as possible.
+// 1 if the final transforms differ from the recorded ones
+static int replay(ResourceManager& resource_manager, const SimOptions& options) {
+    InputReplay replay{};
+    if (!replay.open(options.replay)) return 1;
+    TaskScheduler scheduler(options.workers);
+    // World::default_def(), like the Game that recorded it
+    World world(scheduler);
+    world.far_radius = replay.setup.far_radius;
+    Sectors sectors(world, scheduler, {resource_manager.get_texture("assets/wall01.png"), resource_manager.get_texture("assets/wall02.png")}, replay.setup.seed);
+    sectors.lockstep = true;
+    world.ships.reserve(256);
+    world.chunks.reserve((2 * SECTOR_UNLOAD_RADIUS + 1) * (2 * SECTOR_UNLOAD_RADIUS + 1));
+    const Pool<Ship>::Handle player = world.spawn_ship(resource_manager.get_texture("assets/ship01.png"), Transform(replay.setup.player));
+    if (replay.channels() != 1) LCRITRET(1, "recording has {} controllers, expected the player only", replay.channels());
+    world.ships.get(player)->controller = replay.controller(0);
+
+    using clock = std::chrono::steady_clock;
+    std::vector<double> tick_us{};
+    const clock::time_point start = clock::now();
+    while (replay.next_tick()) {
+        const clock::time_point tick_start = clock::now();
+        if (const Ship* ship = world.ships.get(player)) world.focus = ship->get_transform().pos;
+        sectors.update(world.focus);
+        world.step(replay.setup.dt);
+        tick_us.push_back(std::chrono::duration<double, std::micro>(clock::now() - tick_start).count());
+    }
+    const double seconds = std::chrono::duration<double>(clock::now() - start).count();
+    if (!replay.complete()) LCRITRET(1, "replay stopped after {} ticks", tick_us.size());
+    LINFO("replay: {} ticks, {:.1f} ticks/s ({:.1f}x realtime), {} walls in {} shapes", tick_us.size(), tick_us.size() / seconds,
+          tick_us.size() / seconds * replay.setup.dt, sectors.walls_count(), sectors.shapes_count());
+    LINFO("tick us: p50 {:.1f} p90 {:.1f} p99 {:.1f} max {:.1f}", percentile(tick_us, 0.5), percentile(tick_us, 0.9), percentile(tick_us, 0.99),
+          percentile(tick_us, 1.0));
+    const uint64_t hash = state_hash(world);
+    if (hash != replay.expected_hash()) LCRITRET(1, "replay diverged: state {:016x}, recorded {:016x}", hash, replay.expected_hash());
+    LINFO("state {:016x} matches the recording", hash);
+    PROFILE_DUMP();
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    std::filesystem::current_path(std::filesystem::canonical("/proc/self/exe").parent_path());
+    _init_log(spdlog::level::info);
+    const SimOptions options = parse_options(argc, argv);
+    LINFO("{} headless: {} ships, {} ticks, seed {}", PROJECT_NAME_VERSION, options.ships, options.ticks, options.seed);
+
+    ResourceManager resource_manager{};
+    if (options.replay) return replay(resource_manager, options);
+
+    if (options.scaling) {
+        const uint max_workers = options.workers ? options.workers : std::max(1u, std::thread::hardware_concurrency());
+        std::vector<uint> counts{};
+        for (uint workers = 1; workers < max_workers; workers *= 2) { counts.push_back(workers); }
+        counts.push_back(max_workers);
+        double baseline = 0.0;
+        LINFO("workers | b2World_Step p50 us | p99 us | ticks/s | speedup");
+        for (const uint workers : counts) {
+            TaskScheduler scheduler(workers);
+            Arena arena(resource_manager, scheduler, options);
+            RunResult result = run(arena, options.ticks);
+            const double p50 = percentile(result.step_us, 0.5);
+            if (baseline == 0.0) baseline = p50;
+            LINFO("{:>7} | {:>19.1f} | {:>6.1f} | {:>7.1f} | {:.2f}x", workers, p50, percentile(result.step_us, 0.99), result.ticks_per_second, baseline / p50);
+        }
+        return 0;
+    }
+
+    TaskScheduler scheduler(options.workers);
+    Arena arena(resource_manager, scheduler, options);
+    size_t walls = 0, shapes = 0;
+    for (const StaticChunk& chunk : arena.world.chunks) {
+        walls += chunk.geometry->tiles.size();
+        shapes += chunk.shapes_count();
+    }
+    LINFO("arena: {} walls in {} shapes, {} ships, {} workers", walls, shapes, arena.world.ships.size(), scheduler.workers_count());
+    RunResult result = run(arena, options.ticks, options.rollback);
+
+    LINFO("{} ticks: {:.1f} ticks/s ({:.1f}x realtime)", options.ticks, result.ticks_per_second, result.ticks_per_second / PHYSICS_RATE);
+    LINFO("tick us: p50 {:.1f} p90 {:.1f} p99 {:.1f} max {:.1f}", percentile(result.tick_us, 0.5), percentile(result.tick_us, 0.9),
+          percentile(result.tick_us, 0.99), percentile(result.tick_us, 1.0));
+    LINFO("b2World_Step us: p50 {:.1f} p99 {:.1f}", percentile(result.step_us, 0.5), percentile(result.step_us, 0.99));
+    if (!result.rollback_us.empty()) {
+        LINFO("Rollback::save us: p50 {:.1f} p99 {:.1f}", percentile(result.save_us, 0.5), percentile(result.save_us, 0.99));
+        LINFO("rollback of {} ticks us: p50 {:.1f} p99 {:.1f}", options.rollback, percentile(result.rollback_us, 0.5), percentile(result.rollback_us, 0.99));
+    }
+    LINFO("{} of {} ships in the far tier at the end", arena.world.far_count(), arena.world.ships.size());
+    const ResourceManager::Stats& resources = resource_manager.stats();
+    LINFO("resources: {} lookups, {} loads, {} duplicate loads", resources.lookups, resources.loads, resources.duplicate_loads);
+    PROFILE_DUMP();
+    return 0;
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// four floats at once: SSE2 where the target has it (every x86-64), plain loops otherwise.
+// Comparisons return masks (all bits set or clear per lane) for select()
+struct f32x4 {
+    constexpr static int N = 4;
+#if defined(__SSE2__)
+    __m128 v;
+
+    inline static f32x4 load(const float* p) { return {_mm_loadu_ps(p)}; }
+    inline static f32x4 splat(const float x) { return {_mm_set1_ps(x)}; }
+    inline void store(float* p) const { _mm_storeu_ps(p, v); }
+
+    inline friend f32x4 operator+(const f32x4 a, const f32x4 b) { return {_mm_add_ps(a.v, b.v)}; }
+    inline friend f32x4 operator-(const f32x4 a, const f32x4 b) { return {_mm_sub_ps(a.v, b.v)}; }
+    inline friend f32x4 operator*(const f32x4 a, const f32x4 b) { return {_mm_mul_ps(a.v, b.v)}; }
+    inline friend f32x4 operator/(const f32x4 a, const f32x4 b) { return {_mm_div_ps(a.v, b.v)}; }
+    inline friend f32x4 operator<(const f32x4 a, const f32x4 b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+    inline friend f32x4 operator>(const f32x4 a, const f32x4 b) { return {_mm_cmpgt_ps(a.v, b.v)}; }
+    inline friend f32x4 operator&(const f32x4 a, const f32x4 b) { return {_mm_and_ps(a.v, b.v)}; }
+    inline friend f32x4 operator|(const f32x4 a, const f32x4 b) { return {_mm_or_ps(a.v, b.v)}; }
+    inline friend f32x4 min(const f32x4 a, const f32x4 b) { return {_mm_min_ps(a.v, b.v)}; }
+    inline friend f32x4 max(const f32x4 a, const f32x4 b) { return {_mm_max_ps(a.v, b.v)}; }
+    inline friend f32x4 sqrt(const f32x4 a) { return {_mm_sqrt_ps(a.v)}; }
+    inline friend f32x4 abs(const f32x4 a) { return {_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)}; }
+    // mask ? a : b
+    inline friend f32x4 select(const f32x4 mask, const f32x4 a, const f32x4 b) { return {_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v))}; }
+    // bit i set if lane i of the mask is
+    inline friend int movemask(const f32x4 mask) { return _mm_movemask_ps(mask.v); }
+#else
+    float v[N];
+
+    inline static f32x4 load(const float* p) {
+        f32x4 out;
+        std::memcpy(out.v, p, sizeof(out.v));
+        return out;
+    }
+    inline static f32x4 splat(const float x) { return {{x, x, x, x}}; }
+    inline void store(float* p) const { std::memcpy(p, v, sizeof(v)); }
+
+    template <class F>
+    inline static f32x4 _map(const f32x4 a, const f32x4 b, F&& fn) {
+        f32x4 out;
+        for (int i = 0; i < N; i++) { out.v[i] = fn(a.v[i], b.v[i]); }
+        return out;
+    }
+    inline static float _mask(const bool x) {
+        const uint32_t bits = x ? UINT32_MAX : 0;
+        float out;
+        std::memcpy(&out, &bits, sizeof(out));
+        return out;
+    }
+    inline static uint32_t _bits(const float x) {
+        uint32_t out;
+        std::memcpy(&out, &x, sizeof(out));
+        return out;
+    }
+    inline static float _float(const uint32_t x) {
+        float out;
+        std::memcpy(&out, &x, sizeof(out));
+        return out;
+    }
+
+    inline friend f32x4 operator+(const f32x4 a, const f32x4 b) { return _map(a, b, [](float x, float y) { return x + y; }); }
+    inline friend f32x4 operator-(const f32x4 a, const f32x4 b) { return _map(a, b, [](float x, float y) { return x - y; }); }
+    inline friend f32x4 operator*(const f32x4 a, const f32x4 b) { return _map(a, b, [](float x, float y) { return x * y; }); }
+    inline friend f32x4 operator/(const f32x4 a, const f32x4 b) { return _map(a, b, [](float x, float y) { return x / y; }); }
+    inline friend f32x4 operator<(const f32x4 a, const f32x4 b) { return _map(a, b, [](float x, float y) { return _mask(x < y); }); }
+    inline friend f32x4 operator>(const f32x4 a, const f32x4 b) { return _map(a, b, [](float x, float y) { return _mask(x > y); }); }
+    inline friend f32x4 operator&(const f32x4 a, const f32x4 b) { return _map(a, b, [](float x, float y) { return _float(_bits(x) & _bits(y)); }); }
+    inline friend f32x4 operator|(const f32x4 a, const f32x4 b) { return _map(a, b, [](float x, float y) { return _float(_bits(x) | _bits(y)); }); }
+    inline friend f32x4 min(const f32x4 a, const f32x4 b) { return _map(a, b, [](float x, float y) { return y < x ? y : x; }); }
+    inline friend f32x4 max(const f32x4 a, const f32x4 b) { return _map(a, b, [](float x, float y) { return x < y ? y : x; }); }
+    inline friend f32x4 sqrt(const f32x4 a) { return _map(a, a, [](float x, float) { return std::sqrt(x); }); }
+    inline friend f32x4 abs(const f32x4 a) { return _map(a, a, [](float x, float) { return std::fabs(x); }); }
+    // mask ? a : b
+    inline friend f32x4 select(const f32x4 mask, const f32x4 a, const f32x4 b) {
+        f32x4 out;
+        for (int i = 0; i < N; i++) { out.v[i] = _float((_bits(mask.v[i]) & _bits(a.v[i])) | (~_bits(mask.v[i]) & _bits(b.v[i]))); }
+        return out;
+    }
+    // bit i set if lane i of the mask is
+    inline friend int movemask(const f32x4 mask) {
+        int out = 0;
+        for (int i = 0; i < N; i++) { out |= int(_bits(mask.v[i]) >> 31) << i; }
+        return out;
+    }
+#endif
+    inline friend f32x4 operator-(const f32x4 a) { return splat(0.0f) - a; }
+
+    // radians, off by less than 3e-4, plenty for steering
+    inline friend f32x4 atan2(const f32x4 y, const f32x4 x) {
+        const f32x4 ax = abs(x), ay = abs(y);
+        const f32x4 a = min(ax, ay) / max(max(ax, ay), splat(1e-30f));
+        const f32x4 s = a * a;
+        f32x4 r = ((splat(-0.0464964749f) * s + splat(0.15931422f)) * s - splat(0.327622764f)) * s * a + a;
+        r = select(ay > ax, splat(1.57079637f) - r, r);
+        r = select(x < splat(0.0f), splat(3.14159274f) - r, r);
+        return select(y < splat(0.0f), -r, r);
+    }
+};
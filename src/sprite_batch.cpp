@@ -0,0 +1,157 @@
+#pragma once
+#ifndef HEADLESS
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#endif
+#include <sys/types.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <glm/mat4x4.hpp>
+#include <memory>
+#include <vector>
+
+#include "sprite.cpp"
+#include "texture.cpp"
+#ifndef HEADLESS
+#include "mesh.cpp"
+#include "resource_manager.cpp"
+#include "shader.cpp"
+#include "shaders.hpp"
+#endif
+
+// Collects sprites for a frame, groups them by atlas page and draws every group
+// with one instanced call on the shared 1x1 quad.
+// Headless builds keep only the CPU side (submit() and build()), for benchmarks
+class SpriteBatch {
+public:
+    struct Stats {
+        uint draw_calls = 0;
+        uint instances = 0;
+    };
+
+private:
+    struct Entry {
+        const TexturePage* page;
+        Sprite::Instance instance;
+    };
+    struct Group {
+        const TexturePage* page;
+        size_t first;
+        size_t count;
+    };
+
+    std::vector<Entry> _entries{};
+    std::vector<Sprite::Instance> _instances{};
+    std::vector<Group> _groups{};
+    Stats _stats{};
+
+#ifndef HEADLESS
+    std::shared_ptr<Shader> _shader;
+#ifdef DRAW_DEBUG
+    std::shared_ptr<Shader> _debug_shader;
+#endif
+    std::shared_ptr<Mesh> _mesh;
+    uint _instance_VBO;
+    // in instances
+    size_t _capacity = 0;
+
+    // points instance attributes of the quad VAO at the first instance of a group.
+    // GL 3.3 has no base instance, so the offset is baked into the attribute pointers instead
+    void _bind_instances(const size_t first) {
+        const size_t offset = first * sizeof(Sprite::Instance);
+        glBindBuffer(GL_ARRAY_BUFFER, _instance_VBO);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Sprite::Instance), reinterpret_cast<void*>(offset + offsetof(Sprite::Instance, pos)));
+        glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Sprite::Instance), reinterpret_cast<void*>(offset + offsetof(Sprite::Instance, rot)));
+        glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, sizeof(Sprite::Instance), reinterpret_cast<void*>(offset + offsetof(Sprite::Instance, size)));
+        glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(Sprite::Instance), reinterpret_cast<void*>(offset + offsetof(Sprite::Instance, uv)));
+    }
+    void _upload() {
+        glBindBuffer(GL_ARRAY_BUFFER, _instance_VBO);
+        if (_instances.size() > _capacity) _capacity = std::max(_instances.size(), _capacity * 2);
+        // orphan last frame's storage so the driver does not wait for it
+        glBufferData(GL_ARRAY_BUFFER, sizeof(Sprite::Instance) * _capacity, nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(Sprite::Instance) * _instances.size(), _instances.data());
+    }
+#endif
+
+public:
+    SpriteBatch(const SpriteBatch&) = delete;
+    SpriteBatch& operator=(const SpriteBatch&) = delete;
+#ifdef HEADLESS
+    SpriteBatch() = default;
+#else
+    SpriteBatch(ResourceManager& manager)
+        : _shader(manager.get_shader(VERTEX_SHADER_2D, FRAGMENT_SHADER_2D)),
+#ifdef DRAW_DEBUG
+          _debug_shader(manager.get_shader(VERTEX_SHADER_2D, FRAGMENT_SHADER_2D_SINGLE_COLOR)),
+#endif
+          _mesh(manager.get_quad_1x1()) {
+        glGenBuffers(1, &_instance_VBO);
+        _mesh->use();
+        glBindBuffer(GL_ARRAY_BUFFER, _instance_VBO);
+        for (uint attrib = 2; attrib <= 5; attrib++) {
+            glEnableVertexAttribArray(attrib);
+            glVertexAttribDivisor(attrib, 1);
+        }
+        _bind_instances(0);
+        glBindVertexArray(0);
+    }
+#endif
+
+    // starts a new frame, drops everything submitted before
+    inline void begin() {
+        _entries.clear();
+        _stats = {};
+    }
+    // alpha: see Sprite::get_instance()
+    inline void submit(const Sprite& sprite, const float alpha = 1.0f) { _entries.push_back({sprite.get_texture()->page(), sprite.get_instance(alpha)}); }
+    // sprite state copied off the simulation thread. size: world-space, see Sprite::get_size()
+    inline void submit(const Texture& texture, const glm::vec2& size, const Transform& at) {
+        _entries.push_back({texture.page(), {at.pos, {at.rot.c, at.rot.s}, size, texture.uv()}});
+    }
+
+    // sorts submitted sprites by atlas page and builds instance groups. CPU only, called by draw()
+    void build() {
+        std::sort(_entries.begin(), _entries.end(), [](const Entry& a, const Entry& b) { return a.page < b.page; });
+        _instances.clear();
+        _groups.clear();
+        for (const Entry& entry : _entries) {
+            if (_groups.empty() || _groups.back().page != entry.page) _groups.push_back({entry.page, _instances.size(), 0});
+            _groups.back().count++;
+            _instances.push_back(entry.instance);
+        }
+        _stats.instances = _instances.size();
+    }
+
+#ifndef HEADLESS
+    void draw(const glm::mat4x4& VP) {
+        build();
+        if (_instances.empty()) return;
+        _upload();
+        _shader->use();
+        _shader->set_mat4(Uniform::VP, VP);
+        _mesh->use();
+        for (const Group& group : _groups) {
+            group.page->use(0);
+            _bind_instances(group.first);
+            _mesh->draw_instanced(group.count);
+            _stats.draw_calls++;
+        }
+    }
+#ifdef DRAW_DEBUG
+    // outlines of the sprites uploaded by the last draw()
+    void draw_debug(const glm::mat4x4& VP) {
+        if (_instances.empty()) return;
+        _debug_shader->use();
+        _debug_shader->set_mat4(Uniform::VP, VP);
+        _mesh->use();
+        _bind_instances(0);
+        _mesh->draw_lines_instanced(_instances.size());
+        _stats.draw_calls++;
+    }
+#endif
+#endif
+
+    inline const Stats& stats() const { return _stats; }
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+// bounded lock-free queue for exactly one producer thread and one consumer thread
+template <class T, size_t N>
+class SpscRing {
+    static_assert((N & (N - 1)) == 0, "N must be a power of two");
+    T _items[N]{};
+    // consumer and producer positions on their own cache lines, they only grow
+    alignas(64) std::atomic<size_t> _head{0};
+    alignas(64) std::atomic<size_t> _tail{0};
+
+public:
+    SpscRing() = default;
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // producer, false if full
+    bool push(const T& item) {
+        const size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _head.load(std::memory_order_acquire) == N) return false;
+        _items[tail % N] = item;
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer, nullptr if empty. Valid until pop()
+    const T* peek() const {
+        const size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire)) return nullptr;
+        return &_items[head % N];
+    }
+    inline void pop() { _head.store(_head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+};
@@ -0,0 +1,252 @@
+#pragma once
+#include <box2d/box2d.h>
+#include <box2d/collision.h>
+#include <box2d/id.h>
+#include <box2d/math_functions.h>
+#include <box2d/types.h>
+#include <sys/types.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <glm/geometric.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+#include "body_factory.cpp"
+#include "globals.hpp"
+#include "texture.cpp"
+#include "transform.cpp"
+#ifndef HEADLESS
+#include "mesh.cpp"
+#include "resource_manager.cpp"
+#include "shader.cpp"
+#include "shaders.hpp"
+#endif
+
+// Static scenery baked per chunk (a sector, an arena). Collision boxes of tiles that line up are merged and become
+// the shapes of one static body, the quads of all tiles go into one vertex buffer per atlas page with world-space
+// positions and final UVs. A straight run of walls costs one broadphase proxy instead of one per tile,
+// and a chunk one draw call instead of a sprite per tile
+struct StaticGeometry {
+    // physics units
+    struct Tile {
+        // owned by the ResourceManager
+        const Texture* texture;
+        glm::vec2 size;
+        Transform transform;
+    };
+    // physics units, relative to the chunk origin
+    struct Box {
+        glm::vec2 center;
+        glm::vec2 half;
+        b2Rot rot;
+    };
+    // what the renderer needs, immutable once baked so snapshots can share it
+    struct Chunk {
+        std::vector<Tile> tiles{};
+        // of every tile at any rotation, physics units
+        glm::vec2 min{}, max{};
+    };
+
+    // transform: pixels, like World::spawn_ship()
+    static inline Tile tile(const Texture& texture, const Transform& transform) {
+        return {&texture, glm::vec2(texture.w(), texture.h()) / float(ZOOM_FACTOR), Transform(transform.pos / float(ZOOM_FACTOR), transform.rot)};
+    }
+
+    static std::shared_ptr<const Chunk> bake(std::vector<Tile> tiles) {
+        const std::shared_ptr<Chunk> out = std::make_shared<Chunk>();
+        out->tiles = std::move(tiles);
+        if (out->tiles.empty()) return out;
+        out->min = out->max = out->tiles.front().transform.pos;
+        for (const Tile& tile : out->tiles) {
+            const float radius = glm::length(tile.size) / 2.0f;
+            out->min = glm::min(out->min, tile.transform.pos - radius);
+            out->max = glm::max(out->max, tile.transform.pos + radius);
+        }
+        return out;
+    }
+
+    // boxes of tiles with the same rotation and height on the same line become one where they overlap or touch.
+    // Values closer than EPS count as equal
+    static void merge(const std::vector<Tile>& tiles, const glm::vec2& origin, std::vector<Box>& out) {
+        constexpr float EPS = 1e-3f;
+        struct Span {
+            // rounded to EPS, tiles merge only if all three match
+            int64_t angle, across, height;
+            // along the length of the tile
+            float start, end;
+            float exact_across, half_height;
+            b2Rot rot;
+        };
+        std::vector<Span> spans{};
+        spans.reserve(tiles.size());
+        for (const Tile& tile : tiles) {
+            b2Rot rot = tile.transform.rot;
+            // turned by half a turn it is the same box
+            if (rot.s < 0.0f || (rot.s == 0.0f && rot.c < 0.0f)) rot = {-rot.c, -rot.s};
+            const glm::vec2 u(rot.c, rot.s), n(-rot.s, rot.c);
+            const glm::vec2 pos = tile.transform.pos - origin;
+            const float along = glm::dot(pos, u), across = glm::dot(pos, n);
+            const glm::vec2 half = tile.size / 2.0f;
+            spans.push_back({std::lround(std::atan2(rot.s, rot.c) / EPS), std::lround(across / EPS), std::lround(half.y / EPS), along - half.x, along + half.x,
+                             across, half.y, rot});
+        }
+        std::sort(spans.begin(), spans.end(), [](const Span& a, const Span& b) {
+            return std::tie(a.angle, a.across, a.height, a.start) < std::tie(b.angle, b.across, b.height, b.start);
+        });
+        const auto emit = [&](const Span& span) {
+            const glm::vec2 u(span.rot.c, span.rot.s), n(-span.rot.s, span.rot.c);
+            out.push_back({u * ((span.start + span.end) / 2.0f) + n * span.exact_across, {(span.end - span.start) / 2.0f, span.half_height}, span.rot});
+        };
+        for (size_t i = 0; i < spans.size();) {
+            Span run = spans[i];
+            for (i++; i < spans.size(); i++) {
+                const Span& next = spans[i];
+                if (next.angle != run.angle || next.across != run.across || next.height != run.height || next.start > run.end + EPS) break;
+                run.end = std::max(run.end, next.end);
+            }
+            emit(run);
+        }
+    }
+};
+
+// one static body with a shape per merged box, see StaticGeometry
+class StaticChunk {
+    b2BodyId _body_id;
+    size_t _shapes;
+
+public:
+    // nullptr for chunks that only add shapes to a scenery drawn by another one
+    const std::shared_ptr<const StaticGeometry::Chunk> geometry;
+
+    // origin: physics units, boxes are relative to it
+    StaticChunk(b2WorldId world_id, const glm::vec2& origin, const std::vector<StaticGeometry::Box>& boxes, const std::shared_ptr<const StaticGeometry::Chunk>& geometry)
+        : _shapes(boxes.size()), geometry(geometry) {
+        b2BodyDef def = b2DefaultBodyDef();
+        def.position = {origin.x, origin.y};
+        def.type = b2BodyType::b2_staticBody;
+        _body_id = b2CreateBody(world_id, &def);
+        const b2ShapeDef shape_def = body_factory::_default_shapedef();
+        for (const StaticGeometry::Box& box : boxes) {
+            const b2Polygon polygon = b2MakeOffsetBox(box.half.x, box.half.y, {box.center.x, box.center.y}, box.rot);
+            b2CreatePolygonShape(_body_id, &shape_def, &polygon);
+        }
+    }
+    StaticChunk(const StaticChunk&) = delete;
+    StaticChunk& operator=(const StaticChunk&) = delete;
+    // owns the body, nothing to do if the world is gone already
+    ~StaticChunk() {
+        if (b2Body_IsValid(_body_id)) b2DestroyBody(_body_id);
+    }
+
+    inline size_t shapes_count() const { return _shapes; }
+};
+
+#ifndef HEADLESS
+// GL side of the chunks of a snapshot: meshes are built when a chunk shows up, dropped once it is gone
+// and rebuilt if a texture they baked was swapped meanwhile (see ResourceManager::pump_uploads())
+class StaticBatch {
+public:
+    struct Stats {
+        uint draw_calls = 0;
+        uint chunks = 0;
+    };
+
+private:
+    struct _Group {
+        const TexturePage* page;
+        std::unique_ptr<Mesh> mesh;
+    };
+    struct _Baked {
+        std::shared_ptr<const StaticGeometry::Chunk> chunk;
+        // regions as baked
+        std::vector<std::tuple<const Texture*, const TexturePage*, glm::vec4>> textures{};
+        std::vector<_Group> groups{};
+        uint64_t frame = 0;
+    };
+
+    std::shared_ptr<Shader> _shader;
+    std::vector<_Baked> _baked{};
+    uint64_t _frame = 0;
+    Stats _stats{};
+    std::vector<const StaticGeometry::Tile*> _tiles{};
+    std::vector<Vertex> _vertices{};
+    std::vector<uint> _indices{};
+
+    static bool _stale(const _Baked& baked) {
+        for (const auto& [texture, page, uv] : baked.textures) {
+            if (texture->page() != page || texture->uv() != uv) return true;
+        }
+        return false;
+    }
+    void _build(_Baked& baked) {
+        baked.textures.clear();
+        baked.groups.clear();
+        _tiles.clear();
+        for (const StaticGeometry::Tile& tile : baked.chunk->tiles) _tiles.push_back(&tile);
+        std::sort(_tiles.begin(), _tiles.end(), [](const StaticGeometry::Tile* a, const StaticGeometry::Tile* b) { return a->texture->page() < b->texture->page(); });
+        for (size_t first = 0; first < _tiles.size();) {
+            const TexturePage* page = _tiles[first]->texture->page();
+            _vertices.clear();
+            _indices.clear();
+            size_t i = first;
+            for (; i < _tiles.size() && _tiles[i]->texture->page() == page; i++) {
+                const StaticGeometry::Tile& tile = *_tiles[i];
+                const glm::vec4& uv = tile.texture->uv();
+                const auto known = [&](const auto& baked_texture) { return std::get<0>(baked_texture) == tile.texture; };
+                if (std::none_of(baked.textures.begin(), baked.textures.end(), known)) baked.textures.emplace_back(tile.texture, page, uv);
+                // the corners of the 1x1 quad, turned the way VERTEX_SHADER_2D turns sprites
+                static const Vertex QUAD[] = {{{0.5f, 0.5f}, {1.0f, 1.0f}}, {{0.5f, -0.5f}, {1.0f, 0.0f}}, {{-0.5f, -0.5f}, {0.0f, 0.0f}}, {{-0.5f, 0.5f}, {0.0f, 1.0f}}};
+                const b2Rot rot = tile.transform.rot;
+                const uint base = _vertices.size();
+                for (const Vertex& corner : QUAD) {
+                    const glm::vec2 p = corner.pos * tile.size;
+                    _vertices.push_back({tile.transform.pos + glm::vec2(p.x * rot.c + p.y * rot.s, p.y * rot.c - p.x * rot.s),
+                                         glm::vec2(uv.x, uv.y) + corner.texture * glm::vec2(uv.z, uv.w)});
+                }
+                for (const uint index : {0u, 1u, 3u, 1u, 2u, 3u}) _indices.push_back(base + index);
+            }
+            baked.groups.push_back({page, std::make_unique<Mesh>(_vertices.data(), _vertices.size(), _indices.data(), _indices.size())});
+            first = i;
+        }
+    }
+
+public:
+    StaticBatch(const StaticBatch&) = delete;
+    StaticBatch& operator=(const StaticBatch&) = delete;
+    StaticBatch(ResourceManager& manager) : _shader(manager.get_shader(VERTEX_SHADER_2D_STATIC, FRAGMENT_SHADER_2D)) {}
+
+    // chunks: all of the snapshot, the ones outside of the world-space rectangle [view_min, view_max] are skipped
+    void draw(const std::vector<std::shared_ptr<const StaticGeometry::Chunk>>& chunks, const glm::mat4x4& VP, const glm::vec2& view_min, const glm::vec2& view_max) {
+        _frame++;
+        _stats = {};
+        _shader->use();
+        _shader->set_mat4(Uniform::VP, VP);
+        for (const std::shared_ptr<const StaticGeometry::Chunk>& chunk : chunks) {
+            // a handful of sectors are loaded at a time
+            auto it = std::find_if(_baked.begin(), _baked.end(), [&](const _Baked& baked) { return baked.chunk == chunk; });
+            if (it == _baked.end()) {
+                it = _baked.insert(_baked.end(), _Baked{chunk});
+                _build(*it);
+            } else if (_stale(*it))
+                _build(*it);
+            it->frame = _frame;
+            if (chunk->min.x > view_max.x || chunk->min.y > view_max.y || chunk->max.x < view_min.x || chunk->max.y < view_min.y) continue;
+            _stats.chunks++;
+            for (_Group& group : it->groups) {
+                group.page->use(0);
+                group.mesh->use();
+                group.mesh->draw();
+                _stats.draw_calls++;
+            }
+        }
+        _baked.erase(std::remove_if(_baked.begin(), _baked.end(), [&](const _Baked& baked) { return baked.frame != _frame; }), _baked.end());
+    }
+
+    inline const Stats& stats() const { return _stats; }
+};
+#endif
@@ -0,0 +1,235 @@
+#pragma once
+#include <box2d/types.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "log.cpp"
+
+// Work-stealing thread pool. Every worker owns a deque: it pushes and pops its own jobs from the back
+// and steals from the front of the others when it runs dry.
+// Worker 0 is the thread that created the scheduler (or called make_owner()); it runs jobs only while waiting on them.
+// Threads outside of the pool (render thread, loaders) submit to a shared injector queue that only pool threads drain,
+// so worker 0 never picks up a texture decode in the middle of b2World_Step. While waiting they run jobs of their own group
+class TaskScheduler {
+public:
+    // same shape as b2TaskCallback, so Box2D tasks need no wrapping
+    using TaskFn = void (*)(int start, int end, uint32_t worker, void* context);
+    struct TaskGroup {
+        std::atomic<int> pending{0};
+    };
+
+private:
+    struct Job {
+        TaskFn fn;
+        void* context;
+        int start, end;
+        TaskGroup* group;
+    };
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    std::vector<std::unique_ptr<Queue>> _queues{};
+    // jobs of outside threads, first in first out
+    Queue _injector{};
+    std::vector<std::thread> _threads{};
+    std::atomic<bool> _running{true};
+    std::atomic<int> _queued{0};
+    std::mutex _sleep_mutex{};
+    std::condition_variable _wake{};
+
+    // handed out to Box2D, see _b2_enqueue()
+    std::mutex _groups_mutex{};
+    std::deque<TaskGroup> _groups{};
+    std::vector<TaskGroup*> _free_groups{};
+
+    // pool threads only, see _current(). Shared by every scheduler, so it says which one the thread belongs to
+    struct _Membership {
+        const TaskScheduler* scheduler;
+        int worker;
+    };
+    inline static thread_local _Membership _membership{nullptr, -1};
+    // worker 0
+    std::atomic<std::thread::id> _owner{std::this_thread::get_id()};
+
+    // worker index of the calling thread, -1 for threads that are not part of this scheduler
+    inline int _current() const {
+        if (_membership.scheduler == this) return _membership.worker;
+        return std::this_thread::get_id() == _owner.load(std::memory_order_relaxed) ? 0 : -1;
+    }
+
+    bool _pop(const int worker, Job& out) {
+        Queue& queue = *_queues[worker];
+        std::lock_guard lock(queue.mutex);
+        if (queue.jobs.empty()) return false;
+        out = queue.jobs.back();
+        queue.jobs.pop_back();
+        _queued--;
+        return true;
+    }
+    bool _steal(const int thief, Job& out) {
+        const int n = _queues.size();
+        for (int i = 1; i < n; i++) {
+            Queue& queue = *_queues[(thief + i) % n];
+            std::unique_lock lock(queue.mutex, std::try_to_lock);
+            if (!lock || queue.jobs.empty()) continue;
+            out = queue.jobs.front();
+            queue.jobs.pop_front();
+            _queued--;
+            return true;
+        }
+        return false;
+    }
+    bool _pop_injected(Job& out) {
+        std::lock_guard lock(_injector.mutex);
+        if (_injector.jobs.empty()) return false;
+        out = _injector.jobs.front();
+        _injector.jobs.pop_front();
+        _queued--;
+        return true;
+    }
+    // newest injected job of group, the others may be long (decodes) and are none of the waiter's business
+    bool _pop_injected(const TaskGroup& group, Job& out) {
+        std::lock_guard lock(_injector.mutex);
+        for (auto it = _injector.jobs.rbegin(); it != _injector.jobs.rend(); ++it) {
+            if (it->group != &group) continue;
+            out = *it;
+            _injector.jobs.erase(std::next(it).base());
+            _queued--;
+            return true;
+        }
+        return false;
+    }
+    // worker 0 leaves the injector alone, its waits are on the simulation's critical path
+    inline bool _next(const int worker, Job& out) { return _pop(worker, out) || _steal(worker, out) || (worker > 0 && _pop_injected(out)); }
+    inline void _run(const Job& job, const int worker) {
+        job.fn(job.start, job.end, worker, job.context);
+        job.group->pending.fetch_sub(1, std::memory_order_release);
+    }
+
+    void _worker_loop(const int worker) {
+        _membership = {this, worker};
+        Job job;
+        while (_running.load(std::memory_order_relaxed)) {
+            if (_next(worker, job)) {
+                _run(job, worker);
+                continue;
+            }
+            std::unique_lock lock(_sleep_mutex);
+            _wake.wait(lock, [this] { return _queued.load() > 0 || !_running.load(); });
+        }
+    }
+
+    TaskGroup* _alloc_group() {
+        std::lock_guard lock(_groups_mutex);
+        if (_free_groups.empty()) return &_groups.emplace_back();
+        TaskGroup* out = _free_groups.back();
+        _free_groups.pop_back();
+        return out;
+    }
+    void _free_group(TaskGroup* group) {
+        std::lock_guard lock(_groups_mutex);
+        _free_groups.push_back(group);
+    }
+
+    static void* _b2_enqueue(b2TaskCallback* task, int item_count, int min_range, void* task_context, void* user_context) {
+        TaskScheduler& self = *static_cast<TaskScheduler*>(user_context);
+        // not worth a round trip through the queues, nullptr tells Box2D it is done already
+        if (item_count <= min_range || self.workers_count() == 1) {
+            task(0, item_count, std::max(self._current(), 0), task_context);
+            return nullptr;
+        }
+        TaskGroup* group = self._alloc_group();
+        self.enqueue(*group, task, task_context, item_count, min_range);
+        return group;
+    }
+    static void _b2_finish(void* user_task, void* user_context) {
+        TaskScheduler& self = *static_cast<TaskScheduler*>(user_context);
+        TaskGroup* group = static_cast<TaskGroup*>(user_task);
+        self.wait(*group);
+        self._free_group(group);
+    }
+
+public:
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+    // workers = 0 uses every hardware thread
+    TaskScheduler(uint workers = 0) {
+        if (workers == 0) workers = std::max(1u, std::thread::hardware_concurrency());
+        for (uint i = 0; i < workers; i++) { _queues.push_back(std::make_unique<Queue>()); }
+        for (uint i = 1; i < workers; i++) { _threads.emplace_back(&TaskScheduler::_worker_loop, this, i); }
+        LDEBUG("task scheduler: {} workers", workers);
+    }
+    ~TaskScheduler() {
+        {
+            std::lock_guard lock(_sleep_mutex);
+            _running = false;
+        }
+        _wake.notify_all();
+        for (std::thread& thread : _threads) { thread.join(); }
+    }
+
+    inline uint workers_count() const { return _queues.size(); }
+    // hands worker 0 to the calling thread (a simulation thread driving b2World_Step),
+    // the previous owner becomes an outside thread
+    inline void make_owner() { _owner.store(std::this_thread::get_id(), std::memory_order_relaxed); }
+
+    // splits [0, count) into ranges of at least min_range items
+    void enqueue(TaskGroup& group, TaskFn fn, void* context, const int count, const int min_range = 1) {
+        const int max_chunks = workers_count() * 4;
+        const int chunks = std::clamp(count / std::max(min_range, 1), 1, max_chunks);
+        const int worker = _current();
+        Queue& queue = worker >= 0 ? *_queues[worker] : _injector;
+        group.pending.fetch_add(chunks, std::memory_order_relaxed);
+        {
+            std::lock_guard lock(queue.mutex);
+            for (int i = 0; i < chunks; i++) { queue.jobs.push_back({fn, context, int(int64_t(count) * i / chunks), int(int64_t(count) * (i + 1) / chunks), &group}); }
+            _queued += chunks;
+        }
+        {
+            std::lock_guard lock(_sleep_mutex);
+        }
+        _wake.notify_all();
+    }
+    // runs queued jobs while waiting, threads outside of the scheduler only the ones of group they submitted
+    // (as worker 0, like _b2_enqueue() runs small tasks inline)
+    void wait(TaskGroup& group) {
+        const int worker = _current();
+        Job job;
+        while (group.pending.load(std::memory_order_acquire) > 0) {
+            if (worker >= 0 ? _next(worker, job) : _pop_injected(group, job))
+                _run(job, std::max(worker, 0));
+            else
+                std::this_thread::yield();
+        }
+    }
+    // fn(start, end, worker) over [0, count), blocks until done
+    template <class F>
+    void parallel_for(const int count, const int min_range, F&& fn) {
+        using Fn = std::remove_reference_t<F>;
+        if (count <= 0) return;
+        TaskGroup group{};
+        void* context = const_cast<void*>(static_cast<const void*>(&fn));
+        enqueue(group, [](int start, int end, uint32_t worker, void* context) { (*static_cast<Fn*>(context))(start, end, worker); }, context, count, min_range);
+        wait(group);
+    }
+
+    // def that runs b2World_Step on this pool
+    b2WorldDef attach(b2WorldDef def) {
+        def.workerCount = workers_count();
+        def.enqueueTask = &_b2_enqueue;
+        def.finishTask = &_b2_finish;
+        def.userTaskContext = this;
+        return def;
+    }
+};
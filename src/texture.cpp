@@ -1,47 +1,76 @@
 #pragma once
+#ifndef HEADLESS
 #include <GL/gl.h>
+#endif
 #include <sys/types.h>
-#include <stb_image.h>
+
+#include <glm/vec4.hpp>
 
 #include "log.cpp"
 
-class Texture {
+#ifdef HEADLESS
+// no GL in headless builds, textures only carry their dimensions
+class TexturePage;
+#else
+// single GL texture object, pixels are uploaded by its owner (see TextureAtlas)
+class TexturePage {
     uint _id;
     uint _w, _h;
 
 public:
-    // only get from ResourceManager
-    Texture(const Texture&) = delete;
-    Texture& operator=(const Texture&) = delete;
-    Texture(const char* path) {
-        static uint count = 0;
-        int w, h, nchannels;
-        stbi_set_flip_vertically_on_load(true);
-        u_char* data = stbi_load(path, &w, &h, &nchannels, 0);
-        if (!data)
-            LERR("failed to load texture ({}) {}: {}", count, path, stbi_failure_reason());
-        else {
-            LTRACE("w{} h{} channels{} count{}", w, h, nchannels, count);
-            glGenTextures(1, &_id);
-            glBindTexture(GL_TEXTURE_2D, _id);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-            if (nchannels == 4)
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-            else
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            // glGenerateMipmap(GL_TEXTURE_2D);
-        }
-        stbi_image_free(data);
-        count++;
-        _w = w;
-        _h = h;
+    TexturePage(const TexturePage&) = delete;
+    TexturePage& operator=(const TexturePage&) = delete;
+    // creates RGBA page filled with `data` (or transparent black if nullptr)
+    TexturePage(const uint w, const uint h, const u_char* data = nullptr) : _w(w), _h(h) {
+        glGenTextures(1, &_id);
+        glBindTexture(GL_TEXTURE_2D, _id);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+        LTRACE("texture page {} w{} h{}", _id, w, h);
     }
+    ~TexturePage() { glDeleteTextures(1, &_id); }
 
+    // RGBA, tightly packed
+    void upload(const uint x, const uint y, const uint w, const uint h, const u_char* data) const {
+        glBindTexture(GL_TEXTURE_2D, _id);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    }
     inline void use(const u_char texture_unit) const {
         glActiveTexture(GL_TEXTURE0 + texture_unit);
         glBindTexture(GL_TEXTURE_2D, _id);
     }
-    inline uint w() const {return _w;}
-    inline uint h() const {return _h;}
+    inline uint w() const { return _w; }
+    inline uint h() const { return _h; }
+};
+#endif
+
+// sub-rectangle of a TexturePage
+class Texture {
+    const TexturePage* _page;
+    // u, v, width, height in 0..1 page space
+    glm::vec4 _uv;
+    uint _w, _h;
+
+public:
+    // only get from ResourceManager
+    Texture(const Texture&) = delete;
+    Texture& operator=(const Texture&) = delete;
+    Texture(const TexturePage* page, const glm::vec4& uv, const uint w, const uint h) : _page(page), _uv(uv), _w(w), _h(h) {}
+
+    // swaps a placeholder for the uploaded image (see ResourceManager::pump_uploads())
+    inline void _set_region(const TexturePage* page, const glm::vec4& uv) {
+        _page = page;
+        _uv = uv;
+    }
+
+#ifndef HEADLESS
+    inline void use(const u_char texture_unit) const { _page->use(texture_unit); }
+#endif
+    inline const TexturePage* page() const { return _page; }
+    inline const glm::vec4& uv() const { return _uv; }
+    inline uint w() const { return _w; }
+    inline uint h() const { return _h; }
 };
@@ -22,4 +22,14 @@ struct Transform {
     }
     Transform(const glm::vec2& pos, const double& angle) : pos(pos), rot{float(std::cos(angle)), float(std::sin(angle))} {}
     Transform(const b2Transform& other) : pos(other.p.x, other.p.y), rot(other.q) {}
+
+    // alpha 0..1, rotation is normalized-lerped along the shorter arc
+    static Transform lerp(const Transform& a, const Transform& b, const float alpha) {
+        const glm::vec2 pos = a.pos + (b.pos - a.pos) * alpha;
+        const glm::vec2 rot = glm::vec2(a.rot.c, a.rot.s) * (1.0f - alpha) + glm::vec2(b.rot.c, b.rot.s) * alpha;
+        const float len = glm::length(rot);
+        // half a turn apart, no shorter arc to pick
+        if (len < 1e-6f) return alpha < 0.5f ? a : b;
+        return Transform(pos, b2Rot{rot.x / len, rot.y / len});
+    }
 };
@@ -0,0 +1,40 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// hands the newest T from one writer thread to one reader thread without either waiting on the other.
+// the writer fills write() and publish()es it, the reader gets the last published one from read()
+template <class T>
+class TripleBuffer {
+    // slot indices are packed as back | middle << 2 | front << 4 plus FRESH
+    constexpr static uint8_t FRESH = 1 << 6;
+    T _slots[3]{};
+    // back and front are owned by their threads, middle is swapped through _state
+    std::atomic<uint8_t> _state{0 | 1 << 2 | 2 << 4};
+
+    static inline uint8_t _back(const uint8_t state) { return state & 3; }
+    static inline uint8_t _middle(const uint8_t state) { return state >> 2 & 3; }
+    static inline uint8_t _front(const uint8_t state) { return state >> 4 & 3; }
+
+public:
+    TripleBuffer() = default;
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // writer thread
+    inline T& write() { return _slots[_back(_state.load(std::memory_order_relaxed))]; }
+    // swaps the written slot with the middle one
+    void publish() {
+        uint8_t state = _state.load(std::memory_order_relaxed);
+        while (!_state.compare_exchange_weak(state, _middle(state) | _back(state) << 2 | _front(state) << 4 | FRESH, std::memory_order_acq_rel)) {}
+    }
+
+    // reader thread, stays valid until the next read()
+    const T& read() {
+        uint8_t state = _state.load(std::memory_order_acquire);
+        if (!(state & FRESH)) return _slots[_front(state)];
+        // only the reader clears FRESH, so it is still set if this fails
+        while (!_state.compare_exchange_weak(state, _back(state) | _front(state) << 2 | _middle(state) << 4, std::memory_order_acq_rel)) {}
+        return _slots[_middle(state)];
+    }
+};
@@ -1,10 +1,12 @@
 #pragma once
+#include <algorithm>
 #include <ctime>
 #include <glm/detail/setup.hpp>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/geometric.hpp>
 #include <glm/gtx/vector_angle.hpp>
 #include <glm/vec2.hpp>
+#include <vector>
 
 template <class T>
 bool valid_float(const T& x) {
@@ -55,3 +57,12 @@ struct Timer {
     void set_target(const double& new_target) { target = new_target; }
     Timer(const double& target) : target(target) {}
 };
+
+// p in 0..1, partially sorts samples
+template <class T>
+T percentile(std::vector<T>& samples, const double& p) {
+    if (samples.empty()) return T{};
+    const size_t n = std::min(samples.size() - 1, size_t(p * samples.size()));
+    std::nth_element(samples.begin(), samples.begin() + n, samples.end());
+    return samples[n];
+}
@@ -0,0 +1,193 @@
+#pragma once
+#include <box2d/box2d.h>
+#include <box2d/types.h>
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#include "far_sim.cpp"
+#include "globals.hpp"
+#include "particles.cpp"
+#include "pool.cpp"
+#include "profiler.cpp"
+#include "ship.cpp"
+#include "sprite.cpp"
+#include "static_geometry.cpp"
+#include "task_scheduler.cpp"
+
+// dynamic state of a World between two steps, see World::save(). Statics never move and are left out.
+// Plain arrays that keep their capacity, so saving into a reused state allocates only when the world outgrew it
+struct WorldState {
+    struct ShipState {
+        Pool<Ship>::Handle ship;
+        Ship::BodyState body;
+    };
+    struct ControllerState {
+        Pool<Ship>::Handle ship;
+        std::array<u_char, Ship::IController::STATE_SIZE> state;
+    };
+    // near tier
+    std::vector<ShipState> ships{};
+    std::vector<FarSimulation::State> far{};
+    // of the controllers that have any
+    std::vector<ControllerState> controllers{};
+    glm::vec2 focus{};
+    double far_accumulator = 0.0;
+
+    void reserve(const size_t ships) {
+        this->ships.reserve(ships);
+        far.reserve(ships);
+        controllers.reserve(ships);
+    }
+};
+
+// simulation state shared by the windowed game and headless runs
+class World {
+    b2WorldId _world_id;
+    FarSimulation _far{};
+    // sprites that moved during the previous step
+    std::vector<Sprite*> _moved{};
+
+    // writes transforms of bodies that moved into their sprites (body user data).
+    // cost is proportional to the number of moving bodies, sleeping ones are never touched
+    void _sync_transforms() {
+        // movers of the last step that stopped now rest at their last transform
+        for (Sprite* sprite : _moved) { sprite->prev_transform = sprite->transform; }
+        _moved.clear();
+        const b2BodyEvents events = b2World_GetBodyEvents(_world_id);
+        for (int i = 0; i < events.moveCount; i++) {
+            const b2BodyMoveEvent& event = events.moveEvents[i];
+            Sprite* sprite = static_cast<Sprite*>(event.userData);
+            if (!sprite) continue;
+            sprite->set_transform(event.transform);
+            _moved.push_back(sprite);
+        }
+    }
+
+    void _update_tiers() {
+        const float r = far_radius / ZOOM_FACTOR;
+        // promote a bit inside the radius so ships on the border do not flip every tick
+        _far.promote_near(focus, r * 0.9f);
+        for (auto it = ships.begin(); it != ships.end(); ++it) {
+            if (it->is_far()) continue;
+            const glm::vec2 d = it->get_transform().pos - focus;
+            if (glm::dot(d, d) > r * r) _far.add(&*it, it.handle());
+        }
+    }
+
+public:
+    // spawn_*() and despawn() keep the rest of the world in sync, iterate these directly
+    Pool<Ship> ships{};
+    // baked static scenery, one body per chunk
+    Pool<StaticChunk> chunks{};
+    // center of the active region (usually the player), physics units
+    glm::vec2 focus{};
+    // pixels
+    float far_radius = FAR_SIMULATION_RADIUS;
+    // engine particles of the ships near the focus, appended by step() while emit_exhaust is set. The consumer clears it
+    bool emit_exhaust = false;
+    std::vector<ParticleBurst> exhaust{};
+
+    // recordings replay only if the game and turned_sim build their worlds from the same def, keep both on this one
+    static b2WorldDef default_def() {
+        b2WorldDef def = b2DefaultWorldDef();
+        def.gravity = {0.0f, 0.0f};
+        def.enableContinuous = true;
+        def.enableContactSoftening = true;
+        return def;
+    }
+
+    World(const World&) = delete;
+    World& operator=(const World&) = delete;
+    World(const b2WorldDef& def = default_def()) : _world_id(b2CreateWorld(&def)) {}
+    // steps Box2D on the scheduler's workers
+    World(TaskScheduler& scheduler, const b2WorldDef& def = default_def()) : World(scheduler.attach(def)) {}
+    ~World() { b2DestroyWorld(_world_id); }
+
+    inline b2WorldId& get_id() { return _world_id; }
+
+    // constructs the body in transform (pixels)
+    inline Pool<Ship>::Handle spawn_ship(const std::shared_ptr<Texture>& texture, const Transform& transform) {
+        return ships.spawn(texture, _world_id, transform);
+    }
+    // false if the handle is stale
+    bool despawn(const Pool<Ship>::Handle handle) {
+        Ship* ship = ships.get(handle);
+        if (!ship) return false;
+        if (ship->is_far()) _far.remove(ship);
+        _moved.erase(std::remove(_moved.begin(), _moved.end(), &ship->get_sprite()), _moved.end());
+        return ships.despawn(handle);
+    }
+    // tiles: see StaticGeometry::tile(), merged right here
+    Pool<StaticChunk>::Handle spawn_chunk(std::vector<StaticGeometry::Tile> tiles) {
+        const glm::vec2 origin = tiles.empty() ? glm::vec2{} : tiles.front().transform.pos;
+        std::vector<StaticGeometry::Box> boxes{};
+        StaticGeometry::merge(tiles, origin, boxes);
+        return spawn_chunk(origin, boxes, StaticGeometry::bake(std::move(tiles)));
+    }
+    // boxes merged and geometry baked ahead, ex. on a worker. origin: physics units
+    inline Pool<StaticChunk>::Handle spawn_chunk(const glm::vec2& origin, const std::vector<StaticGeometry::Box>& boxes,
+                                                 const std::shared_ptr<const StaticGeometry::Chunk>& geometry) {
+        return chunks.spawn(_world_id, origin, boxes, geometry);
+    }
+    inline bool despawn(const Pool<StaticChunk>::Handle handle) { return chunks.despawn(handle); }
+
+    inline void step(const double& dt) {
+        {
+            PROFILE_ZONE("World::_update_tiers");
+            _update_tiers();
+        }
+        {
+            PROFILE_ZONE("Ship::physics");
+            for (Ship& ship : ships) {
+                // ships without a controller coast
+                if (!ship.is_far() && ship.controller && !ship.controller->batched) ship.physics(dt, emit_exhaust ? &exhaust : nullptr);
+            }
+        }
+        {
+            PROFILE_ZONE("b2World_Step");
+            b2World_Step(_world_id, dt, PHYSICS_SUBSTEPS_COUNT);
+        }
+        {
+            PROFILE_ZONE("World::_sync_transforms");
+            _sync_transforms();
+        }
+        PROFILE_ZONE("FarSimulation::step");
+        _far.step(dt);
+    }
+    inline size_t far_count() const { return _far.size(); }
+
+    // between steps
+    void save(WorldState& out) const {
+        PROFILE_ZONE("World::save");
+        out.ships.clear();
+        out.controllers.clear();
+        for (auto it = ships.begin(); it != ships.end(); ++it) {
+            if (!it->is_far()) out.ships.push_back({it.handle(), it->save()});
+            WorldState::ControllerState controller{it.handle()};
+            if (it->controller && it->controller->save_state(controller.state.data())) out.controllers.push_back(controller);
+        }
+        _far.save(out.far);
+        out.focus = focus;
+        out.far_accumulator = _far.get_accumulator();
+    }
+    // back to a saved state. Ships spawned since keep theirs and despawned ones stay gone.
+    // Box2D's contacts and warm starting impulses are not part of it, so re-simulating is close to, not bit identical with, the first run
+    void restore(const WorldState& state) {
+        PROFILE_ZONE("World::restore");
+        // first, ships that were near then are promoted here
+        _far.restore(ships, state.far);
+        for (const WorldState::ShipState& saved : state.ships) {
+            if (Ship* ship = ships.get(saved.ship)) ship->restore(saved.body);
+        }
+        for (const WorldState::ControllerState& saved : state.controllers) {
+            Ship* ship = ships.get(saved.ship);
+            if (ship && ship->controller) ship->controller->load_state(saved.state.data());
+        }
+        _far.set_accumulator(state.far_accumulator);
+        focus = state.focus;
+        // sprites snapped to the restored transforms
+        _moved.clear();
+    }
+};